@@ -1,57 +1,356 @@
 #pragma once
+#include <algorithm>
 #include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
 #include <utility>
+#include <vector>
+#include "FrozenTree.h"
+#include "WorkStealingPool.h"
 
 namespace CustomBinaryTree {
-	template <typename KeyType,typename ValueType>
+	//Extra per node data for balancing policies which don't need any
+	struct NoNodeData {};
+
+	//Deleter of nodes allocated on the heap with new
+	struct NodeDelete {
+		template<typename TreeNode>
+		void operator()(TreeNode* node) const {
+			delete node;
+		}
+	};
+
+	template <typename KeyType,typename ValueType,typename NodeData = NoNodeData,typename NodeDeleter = NodeDelete>
 	/*
 	Binary Node with smart pointers as left and right child node
 	So that memory management is not a problem as smart pointer works on RAII concept and 
 	takes care of freeing resources once they are no longer needed.
 	Chosen Unique pointer instead of shared pointer as performance wise it is faster
 	and as good as a raw pointer, also a node in binary tree is execlusive ownership of its parent node
+	NodeData is the bookkeeping the balancing policy keeps in every node (e.g. height for AVL),
+	it is a base class so that an empty one takes no space
+	NodeDeleter comes from the allocator policy of the tree and is stateless so the child pointers stay pointer sized
+	The key is stored only once, as the first of value_, which is what the iterators point to
 	*/
-	struct BinaryNode {
-		KeyType key_;
-		std::pair<KeyType, ValueType> value_;
-		std::unique_ptr<BinaryNode<KeyType, ValueType>> left_;
-		std::unique_ptr<BinaryNode<KeyType, ValueType>> right_;
+	struct BinaryNode : NodeData {
+		using key_type = KeyType;
+		using mapped_type = ValueType;
+		using node_data = NodeData;
+		using node_ptr = std::unique_ptr<BinaryNode<KeyType, ValueType, NodeData, NodeDeleter>, NodeDeleter>;
+		std::pair<const KeyType, ValueType> value_;
+		node_ptr left_;
+		node_ptr right_;
 		//parent_ cannot be a unique pointer as the node's ownership
 		//which it will point to is with it's parent left_ or right_ unique pointer
 		BinaryNode* parent_; 
-		BinaryNode(KeyType k, ValueType v) :key_{ k }, left_{ nullptr }, right_{ nullptr }, parent_{ nullptr }
-		{
-			value_ = std::make_pair(k, v);
+		//constructs the key-value pair in place, takes the same arguments as std::pair
+		template<typename... Args>
+		BinaryNode(Args&&... args) :value_(std::forward<Args>(args)...), left_{ nullptr }, right_{ nullptr }, parent_{ nullptr }
+		{}
+		const KeyType& key() const {
+			return value_.first;
+		}
+	};
+
+	/******** Balancing policies *******/
+	/*
+	A balancing policy provides
+		node_data : extra data stored in every node
+		rebalance(tree, node) : called after insert/erase with the deepest node whose subtree changed,
+		                        restores the policy's invariant on the path from node to the root
+		update(node) : recomputes the node's data from its children, used when the tree links nodes itself
+	The tree gives the policy access to its rotations.
+	*/
+
+	//Plain binary search tree, the height depends on the insertion order
+	//and sorted input turns the tree into a linked list
+	struct Unbalanced {
+		using node_data = NoNodeData;
+
+		template<typename Tree, typename TreeNode>
+		static void rebalance(Tree&, TreeNode*) {}
+		template<typename TreeNode>
+		static void update(TreeNode*) {}
+	};
+
+	/*
+	AVL tree, the heights of the two subtrees of every node differ by at most one,
+	which keeps the height of the tree below 1.44*log2(n+2).
+	rebalance retraces the path up to the root fixing heights and rotating every node which got out of balance,
+	so insert and erase stay O(log(n)).
+	*/
+	struct AVLBalanced {
+		struct node_data {
+			int height_ = 1;
+		};
+
+		template<typename Tree, typename TreeNode>
+		static void rebalance(Tree& tree, TreeNode* node) {
+			while (node != nullptr) {
+				update(node);
+				int balance = balanceFactor(node);
+				if (balance > 1) {
+					//left-right case is turned into left-left case first
+					if (balanceFactor(node->left_.get()) < 0) {
+						rotateLeft(tree, node->left_.get());
+					}
+					node = rotateRight(tree, node);
+				}
+				else if (balance < -1) {
+					//right-left case is turned into right-right case first
+					if (balanceFactor(node->right_.get()) > 0) {
+						rotateRight(tree, node->right_.get());
+					}
+					node = rotateLeft(tree, node);
+				}
+				node = node->parent_;
+			}
+		}
+		template<typename TreeNode>
+		static void update(TreeNode* node) {
+			int leftHeight = height(node->left_.get());
+			int rightHeight = height(node->right_.get());
+			node->height_ = 1 + (leftHeight > rightHeight ? leftHeight : rightHeight);
+		}
+	private:
+		template<typename TreeNode>
+		static int height(const TreeNode* node) {
+			return node == nullptr ? 0 : node->height_;
+		}
+		template<typename TreeNode>
+		static int balanceFactor(const TreeNode* node) {
+			return height(node->left_.get()) - height(node->right_.get());
+		}
+		//rotations move the node down so it has to be updated before its new parent
+		template<typename Tree, typename TreeNode>
+		static TreeNode* rotateLeft(Tree& tree, TreeNode* node) {
+			TreeNode* newRoot = tree.rotateLeft(node);
+			update(node);
+			update(newRoot);
+			return newRoot;
+		}
+		template<typename Tree, typename TreeNode>
+		static TreeNode* rotateRight(Tree& tree, TreeNode* node) {
+			TreeNode* newRoot = tree.rotateRight(node);
+			update(node);
+			update(newRoot);
+			return newRoot;
 		}
 	};
 
+	/******** Node allocator policies *******/
+	/*
+	An allocator policy provides
+		deleter : stateless deleter used by the unique pointers linking the nodes
+		pool<TreeNode> : owned by the tree
+			create(args...) : constructs a node
+			destroy(node) : destroys the node and takes its memory back
+			release() : frees all the memory held by the pool, the nodes have to be destroyed (or trivially destructible) by then
+			frees_in_bulk : true if release() frees the memory of the nodes as well
+	*/
+
+	//Every node is a separate new/delete on the heap
+	struct HeapNodeAllocator {
+		using deleter = NodeDelete;
+
+		template<typename TreeNode>
+		class pool {
+		public:
+			static constexpr bool frees_in_bulk = false;
+
+			template<typename... Args>
+			TreeNode* create(Args&&... args) {
+				return new TreeNode(std::forward<Args>(args)...);
+			}
+			void destroy(TreeNode* node) {
+				delete node;
+			}
+			void release() {}
+		};
+	};
+
+	/*
+	Nodes are carved out of slabs which double in size up to maxSlabSize nodes,
+	so there is one allocation per slab instead of one per node and nodes inserted together sit next to each other.
+	Erased nodes go to a free list which the next insert reuses.
+	The slabs are only given back all at once by release().
+	*/
+	struct ArenaNodeAllocator {
+		//memory belongs to the arena, the deleter only runs the destructor
+		struct deleter {
+			template<typename TreeNode>
+			void operator()(TreeNode* node) const {
+				node->~TreeNode();
+			}
+		};
+
+		template<typename TreeNode>
+		class pool {
+		public:
+			static constexpr bool frees_in_bulk = true;
+
+			pool() = default;
+			pool(pool&& other) :slabs_{ std::move(other.slabs_) }, slabSize_{ other.slabSize_ },
+				freeList_{ other.freeList_ }, next_{ other.next_ }, remaining_{ other.remaining_ }
+			{
+				other.release();
+			}
+			pool(const pool& other) = delete;
+			pool& operator=(const pool& other) = delete;
+
+			template<typename... Args>
+			TreeNode* create(Args&&... args) {
+				Slot* slot = freeList_;
+				if (slot != nullptr) {
+					freeList_ = slot->next_;
+				}
+				else {
+					if (remaining_ == 0) {
+						grow();
+					}
+					slot = next_++;
+					--remaining_;
+				}
+				try {
+					return new (slot) TreeNode(std::forward<Args>(args)...);
+				}
+				catch (...) {
+					//give the slot back if the node couldn't be constructed
+					slot->next_ = freeList_;
+					freeList_ = slot;
+					throw;
+				}
+			}
+			void destroy(TreeNode* node) {
+				node->~TreeNode();
+				Slot* slot = reinterpret_cast<Slot*>(node);
+				slot->next_ = freeList_;
+				freeList_ = slot;
+			}
+			void release() {
+				slabs_.clear();
+				slabSize_ = 0;
+				freeList_ = nullptr;
+				next_ = nullptr;
+				remaining_ = 0;
+			}
+		private:
+			//a free slot stores the link to the next free slot in place of the node
+			union Slot {
+				Slot* next_;
+				alignas(TreeNode) unsigned char node_[sizeof(TreeNode)];
+			};
+			static constexpr size_t firstSlabSize = 64;
+			static constexpr size_t maxSlabSize = 64 * 1024;
+
+			std::vector<std::unique_ptr<Slot[]>> slabs_;
+			size_t slabSize_ = 0;
+			Slot* freeList_ = nullptr;
+			//next never used slot of the last slab and how many of them are left
+			Slot* next_ = nullptr;
+			size_t remaining_ = 0;
+
+			void grow() {
+				slabSize_ = slabSize_ == 0 ? firstSlabSize : std::min(2 * slabSize_, maxSlabSize);
+				slabs_.emplace_back(new Slot[slabSize_]);
+				next_ = slabs_.back().get();
+				remaining_ = slabSize_;
+			}
+		};
+	};
+
+	/******** Augmentations *******/
+	/*
+	An augmentation keeps extra data in every node which is computed from the node's children
+		node_data : the data stored in every node
+		update(node) : recomputes the node's data from its children, called bottom up for every node
+		               on the path of an insert/erase and for the nodes moved by a rotation
+	*/
+
+	//No extra data
+	struct NoAugmentation {
+		struct node_data {};
+		static constexpr bool enabled = false;
+
+		template<typename TreeNode>
+		static void update(TreeNode*) {}
+	};
+
+	//Number of nodes in the subtree of every node, needed by rank, select and count_range
+	struct SubtreeSize {
+		struct node_data {
+			size_t size_ = 1;
+		};
+		static constexpr bool enabled = true;
+
+		template<typename TreeNode>
+		static void update(TreeNode* node) {
+			node->size_ = 1 + size(node->left_.get()) + size(node->right_.get());
+		}
+		template<typename TreeNode>
+		static size_t size(const TreeNode* node) {
+			return node == nullptr ? 0 : node->size_;
+		}
+	};
+
+	//Per node data of the balancing policy and the augmentation together
+	template<typename BalanceData, typename AugmentationData>
+	struct CombinedNodeData : BalanceData, AugmentationData {};
+
 	//forward declare the iterator classes
-	template<typename KeyType, typename ValueType>
+	template<typename TreeNode>
 	class binaryTree_iterator;
 
-	template<typename KeyType, typename ValueType>
+	template<typename TreeNode>
 	class binaryTree_const_iterator;
 
-	template <typename KeyType, typename ValueType>
+	/*
+	BalancePolicy decides how the tree keeps its height in check, Unbalanced (default) or AVLBalanced
+	NodeAllocator decides where the nodes live, HeapNodeAllocator (default) or ArenaNodeAllocator
+	Augmentation is extra data kept in the nodes, NoAugmentation (default) or SubtreeSize for the order statistics
+	*/
+	template <typename KeyType, typename ValueType, typename BalancePolicy = Unbalanced, typename NodeAllocator = HeapNodeAllocator,
+		typename Augmentation = NoAugmentation>
 	class BinaryTree {
 	public:
+		//type defs
+		using TreeNode = BinaryNode<KeyType, ValueType,
+			CombinedNodeData<typename BalancePolicy::node_data, typename Augmentation::node_data>, typename NodeAllocator::deleter>;
+		using iterator = binaryTree_iterator<TreeNode>;
+		using const_iterator = binaryTree_const_iterator<TreeNode>;
+		using value_type = std::pair<const KeyType, ValueType>;
+
 		BinaryTree() :root_{ nullptr }
 		{}
 		//Only can be moved
-		BinaryTree(BinaryTree&& tree) {
+		BinaryTree(BinaryTree&& tree) :pool_{ std::move(tree.pool_) } {
 			root_ = std::move(tree.root_);
+			size_ = tree.size_;
+			tree.size_ = 0;
 		}
 		//Don't allowing copying the tree as we are using unique pointers
 		BinaryTree(const BinaryTree& tree) = delete;
 		BinaryTree& operator=(const BinaryTree& tree) = delete;
-
-		//type defs
-		using TreeNode = BinaryNode<KeyType, ValueType>;
-		using iterator = binaryTree_iterator<KeyType, ValueType>;
-		using const_iterator = binaryTree_const_iterator<KeyType, ValueType>;
+		~BinaryTree() {
+			clear();
+		}
 
 		void insert(KeyType k, ValueType v) {
-			std::unique_ptr<TreeNode> node = std::make_unique<TreeNode>(k,v); //Only in C++14
+			emplace(std::move(k), std::move(v));
+		}
+		iterator insert(value_type&& value) {
+			return emplace(std::move(value));
+		}
+
+		/*
+		Constructs the element in place from the arguments, which are the same as for std::pair<const KeyType, ValueType>
+		Equal keys are allowed, the new element goes after the ones already in the tree
+		Returns: An iterator to the new element
+		*/
+		template<typename... Args>
+		iterator emplace(Args&&... args) {
+			node_ptr node{ pool_.create(std::forward<Args>(args)...) };
 			TreeNode* temp = root_.get();
 			TreeNode* prev = nullptr;
 
@@ -59,7 +358,7 @@ namespace CustomBinaryTree {
 			bool isLeft = false; //flag to tell if the new node will be left child or right child
 			while (temp != nullptr) {
 				prev = temp;
-				if (k < temp->key_) {
+				if (node->key() < temp->key()) {
 					temp = temp->left_.get();
 					isLeft = true;
 				}
@@ -68,17 +367,91 @@ namespace CustomBinaryTree {
 					isLeft = false;
 				}
 			}
-			node.get()->parent_ = prev;
+			return attach(std::move(node), prev, isLeft);
+		}
 
-			if (prev == nullptr) {
-				root_ = std::move(node);
+		/*
+		Inserts an element with the key and the value constructed in place from args,
+		only if there is no element with an equal key yet. Nothing is constructed otherwise.
+		Returns: An iterator to the element with the key and true if it was inserted
+		*/
+		template<typename... Args>
+		std::pair<iterator, bool> try_emplace(const KeyType& key, Args&&... args) {
+			return tryEmplace(key, std::forward<Args>(args)...);
+		}
+		template<typename... Args>
+		std::pair<iterator, bool> try_emplace(KeyType&& key, Args&&... args) {
+			return tryEmplace(std::move(key), std::forward<Args>(args)...);
+		}
+
+		/*
+		Builds a perfectly balanced tree in O(n) from a range of key-value pairs already sorted by key
+		*/
+		template<typename InputIterator>
+		static BinaryTree build_from_sorted(InputIterator first, InputIterator last) {
+			BinaryTree tree;
+			std::vector<node_ptr> created;
+			for (; first != last; ++first) {
+				created.emplace_back(tree.pool_.create((*first).first, (*first).second));
 			}
-			else if (isLeft) {
-				prev->left_ = std::move(node);
+			std::vector<TreeNode*> nodes;
+			nodes.reserve(created.size());
+			for (node_ptr& node : created) {
+				nodes.push_back(node.release());
 			}
-			else {
-				prev->right_ = std::move(node);
+			tree.relink(nodes);
+			return tree;
+		}
+
+		/*
+		Inserts a range of key-value pairs, in any order
+		The batch is sorted and merged with the in order sequence of the tree, which is then relinked
+		into a perfectly balanced tree in O(n + m log(m)) instead of walking from the root for every key.
+		Batches too small to pay for touching every node of the tree are inserted one by one.
+		Equal keys end up after the ones already in the tree, same as insert
+		*/
+		template<typename InputIterator>
+		void insert_batch(InputIterator first, InputIterator last) {
+			std::vector<std::pair<KeyType, ValueType>> batch;
+			for (; first != last; ++first) {
+				batch.emplace_back((*first).first, (*first).second);
+			}
+			std::stable_sort(batch.begin(), batch.end(),
+				[](const std::pair<KeyType, ValueType>& lhs, const std::pair<KeyType, ValueType>& rhs) {
+				return lhs.first < rhs.first;
+			});
+
+			size_t mergedLog = 1;
+			while ((size_t(1) << mergedLog) < size_ + batch.size()) {
+				++mergedLog;
 			}
+			if (batch.size() * mergedLog < size_) {
+				for (std::pair<KeyType, ValueType>& element : batch) {
+					insert(std::move(element.first), std::move(element.second));
+				}
+				return;
+			}
+
+			std::vector<node_ptr> created;
+			created.reserve(batch.size());
+			for (std::pair<KeyType, ValueType>& element : batch) {
+				created.emplace_back(pool_.create(std::move(element.first), std::move(element.second)));
+			}
+			std::vector<TreeNode*> nodes;
+			nodes.reserve(size_ + created.size());
+			auto next = created.begin();
+			for (iterator it = begin(); it != end(); ++it) {
+				TreeNode* node = it.current_;
+				while (next != created.end() && (*next)->key() < node->key()) {
+					nodes.push_back(next->release());
+					++next;
+				}
+				nodes.push_back(node);
+			}
+			for (; next != created.end(); ++next) {
+				nodes.push_back(next->release());
+			}
+			relink(nodes);
 		}
 		//Runs in O(h) time where h is the height of the tree (log(n))
 		void erase(const KeyType& key) {
@@ -88,78 +461,190 @@ namespace CustomBinaryTree {
 			}
 		}
 
-		//Runs in Constant time
+		//Runs in Constant time for an unbalanced tree, balanced trees retrace the path to the root in O(log(n))
 		void erase(iterator position) {
-			if (position.current_->left_ == nullptr) {
+			TreeNode* node = position.current_;
+			//deepest node whose subtree lost a node, this is where rebalancing starts
+			TreeNode* changed = node->parent_;
+			node_ptr removed;
+			if (node->left_ == nullptr) {
 				//first node is the node which has to be replaced
 				//second is the node which will replace the first node
-				transplant(position.current_, position.current_->right_.get());
+				removed = transplant(node, node->right_.get());
 			}
-			else if (position.current_->right_ == nullptr) {
+			else if (node->right_ == nullptr) {
 				//first node is the node which has to be replaced
 				//second is the node which will replace the first node
-				transplant(position.current_, position.current_->left_.get());
+				removed = transplant(node, node->left_.get());
 			}
 			else {
-				iterator nextMin = Min(position.current_->right_.get());
+				TreeNode* nextMin = Min(node->right_.get()).current_;
+				node_ptr successor;
 
 				//Check if this min node is right node of the node to be deleted
-				if (nextMin.current_->parent_ != position.current_) {
+				if (nextMin->parent_ != node) {
+					changed = nextMin->parent_;
 					//the minimum node found(nextMin) will definatly have only right child
 					//because if there had been any left child then Min() would have returned that
-					std::unique_ptr<TreeNode> replacedMin = transplant(nextMin.current_, nextMin.current_->right_.get());
-					replacedMin.get()->right_ = std::move(position.current_->right_);
-					replacedMin.get()->right_.get()->parent_ = replacedMin.get();
+					successor = transplant(nextMin, nextMin->right_.get());
+					successor->right_ = std::move(node->right_);
+					successor->right_->parent_ = nextMin;
+				}
+				else {
+					//if yes it means there is not left child for the min node and it can replace
+					//the node to be deleted keeping its own right subtree
+					changed = nextMin;
+					successor = std::move(node->right_);
+				}
 
-					//fix the left and parent of the new successor
-					replacedMin.get()->left_ = std::move(position.current_->left_);
-					replacedMin.get()->left_.get()->parent_ = replacedMin.get();
-					replacedMin.get()->parent_ = position.current_->parent_;
+				//fix the left and parent of the new successor
+				successor->left_ = std::move(node->left_);
+				successor->left_->parent_ = nextMin;
+				successor->parent_ = node->parent_;
 
-					if (position.current_->parent_->right_.get() == position.current_) {
-						position.current_->parent_->right_ = std::move(replacedMin);
-					}
-					else {
-						position.current_->parent_->left_ = std::move(replacedMin);
-					}
+				//node has no children left, put the successor in its place
+				node_ptr& slot = owner(node);
+				removed = std::move(slot);
+				slot = std::move(successor);
+			}
+			pool_.destroy(removed.release());
+			--size_;
+			updatePath(changed);
+			BalancePolicy::rebalance(*this, changed);
+		}
 
+		/*
+		Removes all the elements in O(n)
+		Nodes are destroyed bottom up following the parent pointers instead of letting the unique pointers
+		destroy each other recursively, which would overflow the call stack for a deep (degenerate) tree.
+		If the allocator frees the nodes in bulk and there is nothing to destruct, no node is visited at all.
+		*/
+		void clear() {
+			if (NodePool::frees_in_bulk && std::is_trivially_destructible<KeyType>::value &&
+				std::is_trivially_destructible<ValueType>::value &&
+				std::is_trivially_destructible<typename TreeNode::node_data>::value) {
+				//links between the nodes are dropped along with the memory
+				root_.release();
+				pool_.release();
+				size_ = 0;
+				return;
+			}
+			TreeNode* node = root_.release();
+			while (node != nullptr) {
+				if (node->left_ != nullptr) {
+					node = node->left_.release();
+				}
+				else if (node->right_ != nullptr) {
+					node = node->right_.release();
 				}
 				else {
-					//if yes it means there is not left child for the min node and it can replace
-					//the node to be deleted
-					//Move the ownership of the leftChild of the node to be deleted
-					std::unique_ptr<TreeNode> leftChild = std::move(position.current_->left_);
-					transplant(position.current_, nextMin.current_);
-
-					//After replacing the next minimum node at node to be deleted position
-					//add the left child to the new node
-					nextMin.current_->left_ = std::move(leftChild);
-					nextMin.current_->left_.get()->parent_ = nextMin.current_;
+					//leaf, parent's link to it has been released already
+					TreeNode* parent = node->parent_;
+					pool_.destroy(node);
+					node = parent;
 				}
 			}
+			pool_.release();
+			size_ = 0;
 		}
 
 		/* 
 		Searches the given key in the binary tree
+		The key can be of any type comparable with KeyType (e.g. std::string_view for std::string keys),
+		so a lookup doesn't have to construct a temporary KeyType
 		Returns: An iterator to the element, if an element with specified key is found, or BinaryTree::end otherwise.
 		*/
-		iterator find(const KeyType& key) {
+		template<typename Key>
+		iterator find(const Key& key) {
 			TreeNode* temp = root_.get();
-			if (root_ != nullptr){
-				while (temp != nullptr ) {
-					if (key == temp->key_) {
-						break;
-					}
-					else if (key < temp->key_) {
-						temp = temp->left_.get();
-					}
-					else {
-						temp = temp->right_.get();
-					}
+			while (temp != nullptr) {
+				if (key < temp->key()) {
+					temp = temp->left_.get();
+				}
+				else if (temp->key() < key) {
+					temp = temp->right_.get();
+				}
+				else {
+					break;
+				}
+			}
+			return iterator(temp);
+		}
+		//Returns: An iterator to the first element whose key is not less than the given key, or end if there is none
+		iterator lower_bound(const KeyType& key) {
+			TreeNode* temp = root_.get();
+			TreeNode* bound = nullptr;
+			while (temp != nullptr) {
+				if (temp->key() < key) {
+					temp = temp->right_.get();
+				}
+				else {
+					bound = temp;
+					temp = temp->left_.get();
+				}
+			}
+			return iterator(bound);
+		}
+		//Returns: An iterator to the first element whose key is greater than the given key, or end if there is none
+		iterator upper_bound(const KeyType& key) {
+			TreeNode* temp = root_.get();
+			TreeNode* bound = nullptr;
+			while (temp != nullptr) {
+				if (key < temp->key()) {
+					bound = temp;
+					temp = temp->left_.get();
+				}
+				else {
+					temp = temp->right_.get();
+				}
+			}
+			return iterator(bound);
+		}
+
+		/******** Order statistics, need the SubtreeSize augmentation, all run in O(h) *******/
+		//Number of elements whose key is less than the given key
+		size_t rank(const KeyType& key) const {
+			static_assert(std::is_same<Augmentation, SubtreeSize>::value, "rank needs the SubtreeSize augmentation");
+			const TreeNode* temp = root_.get();
+			size_t smaller = 0;
+			while (temp != nullptr) {
+				if (temp->key() < key) {
+					smaller += SubtreeSize::size(temp->left_.get()) + 1;
+					temp = temp->right_.get();
+				}
+				else {
+					temp = temp->left_.get();
+				}
+			}
+			return smaller;
+		}
+		//Returns: An iterator to the k-th smallest element (counting from 0), or end if k is not less than size()
+		iterator select(size_t k) {
+			static_assert(std::is_same<Augmentation, SubtreeSize>::value, "select needs the SubtreeSize augmentation");
+			TreeNode* temp = root_.get();
+			while (temp != nullptr) {
+				size_t leftSize = SubtreeSize::size(temp->left_.get());
+				if (k < leftSize) {
+					temp = temp->left_.get();
+				}
+				else if (k == leftSize) {
+					break;
+				}
+				else {
+					k -= leftSize + 1;
+					temp = temp->right_.get();
 				}
 			}
 			return iterator(temp);
 		}
+		//Number of elements whose key is in [first, last)
+		size_t count_range(const KeyType& first, const KeyType& last) const {
+			if (!(first < last)) {
+				return 0;
+			}
+			return rank(last) - rank(first);
+		}
+
 		iterator Min() {
 			return Min(root_.get());
 		}
@@ -174,6 +659,110 @@ namespace CustomBinaryTree {
 			return iterator(temp);
 		}
 		
+		size_t size() const {
+			return size_;
+		}
+		bool empty() const {
+			return size_ == 0;
+		}
+
+		/*
+		Number of nodes on the longest path from the root to a leaf, 0 for an empty tree
+		Uses an explicit stack instead of recursion so that degenerate trees don't overflow the call stack
+		*/
+		size_t height() const {
+			size_t maxHeight = 0;
+			std::vector<std::pair<const TreeNode*, size_t>> pending;
+			if (root_ != nullptr) {
+				pending.emplace_back(root_.get(), 1);
+			}
+			while (!pending.empty()) {
+				const TreeNode* node = pending.back().first;
+				size_t depth = pending.back().second;
+				pending.pop_back();
+				if (depth > maxHeight) {
+					maxHeight = depth;
+				}
+				if (node->left_ != nullptr) {
+					pending.emplace_back(node->left_.get(), depth + 1);
+				}
+				if (node->right_ != nullptr) {
+					pending.emplace_back(node->right_.get(), depth + 1);
+				}
+			}
+			return maxHeight;
+		}
+
+		/*
+		Returns an immutable copy of the tree laid out for fast searching, see FrozenTree
+		Runs in O(n), later changes to this tree are not reflected in the copy
+		*/
+		FrozenTree<KeyType, ValueType> freeze() {
+			return FrozenTree<KeyType, ValueType>(begin(), end());
+		}
+
+		/*
+		Calls function(element) for every element on the threads of the pool, function may modify the value
+		The tree is split into disjoint subtrees which are processed in parallel (each one in order) so function
+		has to be safe to call concurrently for different elements. The tree must not be modified meanwhile.
+		Only whole subtrees are split off, a degenerate (list like) tree can't be split and runs on one thread.
+		*/
+		template<typename Function>
+		void parallel_for_each(Function function, WorkStealingPool& pool = WorkStealingPool::shared()) {
+			std::vector<std::pair<TreeNode*, bool>> pieces;
+			split(root_.get(), splitDepth(pool), pieces);
+			TaskGroup group(pool);
+			for (std::pair<TreeNode*, bool>& piece : pieces) {
+				if (piece.second) {
+					TreeNode* subtree = piece.first;
+					group.run([subtree, &function] { inOrder(subtree, function); });
+				}
+			}
+			for (std::pair<TreeNode*, bool>& piece : pieces) {
+				if (!piece.second) {
+					function(piece.first->value_);
+				}
+			}
+			group.wait();
+		}
+
+		/*
+		Folds all the elements in order on the threads of the pool
+			reduce(T, const value_type&) -> T folds an element into a partial result
+			combine(T, T) -> T joins the partial results of two consecutive ranges
+		Every disjoint subtree is folded from identity in parallel and the partial results are then combined in order,
+		so the result is the same as a sequential fold as long as combine is associative and identity is its identity,
+		combine doesn't have to be commutative.
+		*/
+		template<typename T, typename Reduce, typename Combine>
+		T parallel_reduce(T identity, Reduce reduce, Combine combine, WorkStealingPool& pool = WorkStealingPool::shared()) {
+			std::vector<std::pair<TreeNode*, bool>> pieces;
+			split(root_.get(), splitDepth(pool), pieces);
+			std::vector<T> partials(pieces.size(), identity);
+			TaskGroup group(pool);
+			for (size_t i = 0; i < pieces.size(); ++i) {
+				if (pieces[i].second) {
+					TreeNode* subtree = pieces[i].first;
+					T* partial = &partials[i];
+					group.run([subtree, partial, &reduce] {
+						auto fold = [partial, &reduce](const value_type& element) {
+							*partial = reduce(std::move(*partial), element);
+						};
+						inOrder(subtree, fold);
+					});
+				}
+				else {
+					partials[i] = reduce(std::move(partials[i]), pieces[i].first->value_);
+				}
+			}
+			group.wait();
+			T result = std::move(identity);
+			for (T& partial : partials) {
+				result = combine(std::move(result), std::move(partial));
+			}
+			return result;
+		}
+
 		//iterator related functionality
 		//begin function returns iterator to the left most element of the tree
 		//iteration using begin and end does an inorder traversal
@@ -201,58 +790,223 @@ namespace CustomBinaryTree {
 			return const_iterator(nullptr);
 		}
 	private:
-		std::unique_ptr<TreeNode> root_;
+		using node_ptr = typename TreeNode::node_ptr;
+		using NodePool = typename NodeAllocator::template pool<TreeNode>;
+
+		//pool is declared first so that it outlives the nodes
+		NodePool pool_;
+		node_ptr root_;
+		size_t size_ = 0;
 
 		//This is to allow the iterator class the access to private section
-		friend class binaryTree_iterator<KeyType, ValueType>;
-		friend class binaryTree_const_iterator<KeyType, ValueType>;
+		friend class binaryTree_iterator<TreeNode>;
+		friend class binaryTree_const_iterator<TreeNode>;
+		//Balancing policy needs the rotations
+		friend BalancePolicy;
+
+		//returns the unique pointer owning the node, it is either root_ or left_/right_ of its parent
+		node_ptr& owner(TreeNode* node) {
+			if (node->parent_ == nullptr) {
+				return root_;
+			}
+			if (node->parent_->left_.get() == node) {
+				return node->parent_->left_;
+			}
+			return node->parent_->right_;
+		}
 
 		//first node is the node which has to be replaced
-		//second is the node which will replace the first node
-		std::unique_ptr<TreeNode> transplant(TreeNode* u, TreeNode* v) {
-			//Save a pointer to u's parent as it might get deleted during
-			//pointer movement later
+		//second is the node which will replace the first node, it has to be either null or a child of the first node
+		//Returns the ownership of the replaced node
+		node_ptr transplant(TreeNode* u, TreeNode* v) {
+			//Save a pointer to u's parent as u's links are moved around below
 			TreeNode* uParent = u->parent_;
-			std::unique_ptr<TreeNode> nodeToBeDeleted;
-			if (u->parent_ == nullptr) { //When u was root, now v becomes root
+			//need to move the ownership of v out of u first as these are unique pointers
+			node_ptr replacement;
+			if (v != nullptr) {
 				if (u->right_.get() == v) {
-					nodeToBeDeleted = std::move(u->right_);
+					replacement = std::move(u->right_);
 				}
 				else {
-					nodeToBeDeleted = std::move(u->left_);
+					replacement = std::move(u->left_);
 				}
-				root_ = std::move(nodeToBeDeleted);
 			}
-			//depending on which side is u of its parent node
-			//we need to either update left or right node of u's parent to v
-			else if (u->parent_->left_.get() == u) {
-				nodeToBeDeleted = std::move(u->parent_->left_);
-				//two cases v either can be right to the node to be deleted or left
-				//need to move the ownership as these are unique pointers
-				if (nodeToBeDeleted.get()->right_.get() == v) {
-					u->parent_->left_ = std::move(nodeToBeDeleted.get()->right_);
-				}
-				else {
-					u->parent_->left_ = std::move(nodeToBeDeleted.get()->left_);
-				}
+			//depending on which side is u of its parent node (or if u was root)
+			//we need to update either left or right node of u's parent (or root) to v
+			node_ptr& slot = owner(u);
+			node_ptr nodeToBeDeleted = std::move(slot);
+			slot = std::move(replacement);
+
+			if (v != nullptr) {
+				v->parent_ = uParent;
+			}
+
+			return nodeToBeDeleted;
+		}
+
+		/*
+		Rotations keep the in order sequence and are used by the balancing policies
+		Left rotation moves x down to the left and its right child y takes its place,
+		y's left subtree becomes x's right subtree. Right rotation is the mirror image.
+		Return the new root of the rotated subtree
+		*/
+		TreeNode* rotateLeft(TreeNode* x) {
+			node_ptr& slot = owner(x);
+			node_ptr xOwned = std::move(slot);
+			node_ptr yOwned = std::move(x->right_);
+			TreeNode* y = yOwned.get();
+
+			x->right_ = std::move(y->left_);
+			if (x->right_ != nullptr) {
+				x->right_->parent_ = x;
+			}
+			y->parent_ = x->parent_;
+			x->parent_ = y;
+			y->left_ = std::move(xOwned);
+			slot = std::move(yOwned);
+			Augmentation::update(x);
+			Augmentation::update(y);
+			return y;
+		}
+		TreeNode* rotateRight(TreeNode* x) {
+			node_ptr& slot = owner(x);
+			node_ptr xOwned = std::move(slot);
+			node_ptr yOwned = std::move(x->left_);
+			TreeNode* y = yOwned.get();
+
+			x->left_ = std::move(y->right_);
+			if (x->left_ != nullptr) {
+				x->left_->parent_ = x;
+			}
+			y->parent_ = x->parent_;
+			x->parent_ = y;
+			y->right_ = std::move(xOwned);
+			slot = std::move(yOwned);
+			Augmentation::update(x);
+			Augmentation::update(y);
+			return y;
+		}
+
+		/*
+		Throws away the current links and links the given nodes, which have to be in order,
+		into a perfectly balanced tree. Every node takes the middle of its range so the sizes of
+		two sibling subtrees differ by at most one, which also satisfies the balancing policies.
+		*/
+		void relink(std::vector<TreeNode*>& nodes) {
+			for (TreeNode* node : nodes) {
+				node->left_.release();
+				node->right_.release();
+			}
+			root_.release();
+			root_.reset(link(nodes, 0, nodes.size(), nullptr));
+			size_ = nodes.size();
+		}
+		//links nodes [first, last) under the parent and returns the root of that subtree
+		TreeNode* link(std::vector<TreeNode*>& nodes, size_t first, size_t last, TreeNode* parent) {
+			if (first == last) {
+				return nullptr;
+			}
+			size_t middle = first + (last - first) / 2;
+			TreeNode* node = nodes[middle];
+			node->parent_ = parent;
+			node->left_.reset(link(nodes, first, middle, node));
+			node->right_.reset(link(nodes, middle + 1, last, node));
+			BalancePolicy::update(node);
+			Augmentation::update(node);
+			return node;
+		}
+
+		//links the new node as a child of parent (or as the root if there is no parent) and rebalances
+		iterator attach(node_ptr node, TreeNode* parent, bool isLeft) {
+			TreeNode* newNode = node.get();
+			newNode->parent_ = parent;
+			if (parent == nullptr) {
+				root_ = std::move(node);
+			}
+			else if (isLeft) {
+				parent->left_ = std::move(node);
 			}
 			else {
-				nodeToBeDeleted = std::move(u->parent_->right_);
-				//two cases v either can be right to the node to be deleted or left
-				//need to move the ownership as these are unique pointers
-				if (nodeToBeDeleted.get()->right_.get() == v) {
-					u->parent_->right_ = std::move(nodeToBeDeleted.get()->right_);
+				parent->right_ = std::move(node);
+			}
+			++size_;
+			updatePath(parent);
+			BalancePolicy::rebalance(*this, newNode);
+			return iterator(newNode);
+		}
+
+		template<typename Key, typename... Args>
+		std::pair<iterator, bool> tryEmplace(Key&& key, Args&&... args) {
+			TreeNode* temp = root_.get();
+			TreeNode* prev = nullptr;
+			bool isLeft = false;
+			while (temp != nullptr) {
+				prev = temp;
+				if (key < temp->key()) {
+					temp = temp->left_.get();
+					isLeft = true;
+				}
+				else if (temp->key() < key) {
+					temp = temp->right_.get();
+					isLeft = false;
 				}
 				else {
-					u->parent_->right_ = std::move(nodeToBeDeleted.get()->left_);
+					return std::make_pair(iterator(temp), false);
 				}
 			}
+			node_ptr node{ pool_.create(std::piecewise_construct, std::forward_as_tuple(std::forward<Key>(key)),
+				std::forward_as_tuple(std::forward<Args>(args)...)) };
+			return std::make_pair(attach(std::move(node), prev, isLeft), true);
+		}
 
-			if (v != nullptr) {
-				v->parent_ = uParent;
+		//recomputes the augmentation of the node and all its ancestors, O(h)
+		void updatePath(TreeNode* node) {
+			if (!Augmentation::enabled) {
+				return;
+			}
+			for (; node != nullptr; node = node->parent_) {
+				Augmentation::update(node);
 			}
+		}
 
-			return std::move(nodeToBeDeleted);
+		//enough pieces for every worker to steal a few times
+		static size_t splitDepth(const WorkStealingPool& pool) {
+			size_t depth = 4;
+			while ((size_t(1) << (depth - 4)) < pool.size()) {
+				++depth;
+			}
+			return depth;
+		}
+		/*
+		Splits the subtree into disjoint pieces in in order sequence, the subtrees depth levels below node
+		(second is true) and the single nodes above them (second is false)
+		*/
+		static void split(TreeNode* node, size_t depth, std::vector<std::pair<TreeNode*, bool>>& pieces) {
+			if (node == nullptr) {
+				return;
+			}
+			if (depth == 0) {
+				pieces.emplace_back(node, true);
+				return;
+			}
+			split(node->left_.get(), depth - 1, pieces);
+			pieces.emplace_back(node, false);
+			split(node->right_.get(), depth - 1, pieces);
+		}
+		//in order traversal of the subtree with an explicit stack, it never leaves the subtree through parent_
+		template<typename Function>
+		static void inOrder(TreeNode* node, Function& function) {
+			std::vector<TreeNode*> pending;
+			while (node != nullptr || !pending.empty()) {
+				while (node != nullptr) {
+					pending.push_back(node);
+					node = node->left_.get();
+				}
+				node = pending.back();
+				pending.pop_back();
+				function(node->value_);
+				node = node->right_.get();
+			}
 		}
 
 		//given the root of the tree it returns iterator to the min element in the tree
@@ -269,11 +1023,10 @@ namespace CustomBinaryTree {
 	};
 
 	/******** Iterators *******/
-	template<typename KeyType, typename ValueType>
+	template<typename TreeNode>
 	class binaryTree_iterator {
 	public:
-		using TreeNode = BinaryNode<KeyType, ValueType>;
-		using iterator = binaryTree_iterator<KeyType, typename ValueType>;
+		using iterator = binaryTree_iterator<TreeNode>;
 		//Equaltiy check operators
 		bool operator == (const iterator& rhs) const{
 			return current_ == rhs.current_;
@@ -302,14 +1055,15 @@ namespace CustomBinaryTree {
 
 		//Necessary traits
 		typedef std::bidirectional_iterator_tag iterator_category;
-		typedef ValueType value_type;
+		typedef typename TreeNode::mapped_type value_type;
 		typedef int difference_type;
 	protected:
 		binaryTree_iterator(TreeNode* curr) {
 			current_ = curr;
 		}
 	private:
-		friend class BinaryTree<KeyType, ValueType>;
+		template<typename, typename, typename, typename, typename>
+		friend class BinaryTree;
 		TreeNode* current_;
 		//Sets the current_ to next element in the in order traversal
 		void nextNode() {
@@ -330,11 +1084,10 @@ namespace CustomBinaryTree {
 		}
 	};
 
-	template<typename KeyType, typename ValueType>
+	template<typename TreeNode>
 	class binaryTree_const_iterator {
 	public:
-		using TreeNode = BinaryNode<KeyType, ValueType>;
-		using const_iterator = binaryTree_const_iterator<KeyType, typename ValueType>;
+		using const_iterator = binaryTree_const_iterator<TreeNode>;
 		//Equaltiy check operators
 		bool operator == (const const_iterator& rhs) const {
 			return current_ == rhs.current_;
@@ -355,23 +1108,24 @@ namespace CustomBinaryTree {
 
 		//post-increment operator
 		const const_iterator operator ++(int) {
-			iterator temp = *this;
+			const_iterator temp = *this;
 			nextNode();
 			return temp;
 		}
 
 		//Necessary traits
 		typedef std::bidirectional_iterator_tag iterator_category;
-		typedef ValueType value_type;
+		typedef typename TreeNode::mapped_type value_type;
 		typedef int difference_type;
 	protected:
-		binaryTree_const_iterator(BinaryNode<KeyType,ValueType>* curr) {
+		binaryTree_const_iterator(TreeNode* curr) {
 			current_ = curr;
 		}
 	private:
 		//Allow the Binary tree class to access private members
-		friend class BinaryTree<KeyType,ValueType>;
-		BinaryNode<KeyType,ValueType>* current_;
+		template<typename, typename, typename, typename, typename>
+		friend class BinaryTree;
+		TreeNode* current_;
 
 		//Sets the current_ to next element in the in order traversal
 		void nextNode() {
@@ -0,0 +1,308 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BinaryTree.h"
+#include "ConcurrentBinaryTree.h"
+#include "MappedTree.h"
+
+using namespace std;
+using namespace CustomBinaryTree;
+
+/*
+Benchmarks of the binary trees, build with optimizations
+	BinaryTree_Bench allocator : inserts and teardown with HeapNodeAllocator and ArenaNodeAllocator
+	BinaryTree_Bench freeze    : find in an AVL tree against find in its FrozenTree
+	BinaryTree_Bench concurrent: ConcurrentBinaryTree reads per second for 1 to max(32, cores) readers while a writer inserts and erases
+	BinaryTree_Bench mapped    : cold start from a text dump against opening a MappedTree, writes two files into the current directory
+	BinaryTree_Bench node      : bytes per node with the key stored once against the previous node which kept a copy of it,
+	                             then inserts per second of 24 character string keys through insert, emplace and try_emplace
+	BinaryTree_Bench parallel [count] : parallel_reduce over count nodes (4M by default) on pools of 1, 2, 4 ... up to
+	                                    as many workers as cores, against an iterator loop
+*/
+typedef chrono::steady_clock Clock;
+
+double millisecondsSince(Clock::time_point start) {
+	return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+template<typename BalancePolicy, typename NodeAllocator>
+void insertAndTeardown(const char* name, const vector<int>& keys) {
+	Clock::time_point start = Clock::now();
+	unique_ptr<BinaryTree<int, int, BalancePolicy, NodeAllocator>> tree(new BinaryTree<int, int, BalancePolicy, NodeAllocator>());
+	for (int key : keys) {
+		tree->insert(key, key);
+	}
+	double insert = millisecondsSince(start);
+	start = Clock::now();
+	tree.reset();
+	double teardown = millisecondsSince(start);
+	printf("%-28s insert %6.1f Mops/s  teardown %8.2f ms\n", name, keys.size() / insert / 1e3, teardown);
+}
+
+void benchAllocator() {
+	mt19937 random(7);
+	vector<int> keys(2000000);
+	for (int& key : keys) {
+		key = random();
+	}
+	insertAndTeardown<Unbalanced, HeapNodeAllocator>("unbalanced heap, random", keys);
+	insertAndTeardown<Unbalanced, ArenaNodeAllocator>("unbalanced arena, random", keys);
+	insertAndTeardown<AVLBalanced, HeapNodeAllocator>("avl heap, random", keys);
+	insertAndTeardown<AVLBalanced, ArenaNodeAllocator>("avl arena, random", keys);
+	for (size_t i = 0; i < keys.size(); ++i) {
+		keys[i] = static_cast<int>(i);
+	}
+	insertAndTeardown<AVLBalanced, HeapNodeAllocator>("avl heap, sorted", keys);
+	insertAndTeardown<AVLBalanced, ArenaNodeAllocator>("avl arena, sorted", keys);
+	//an unbalanced tree of sorted keys is a list 100K nodes deep, clear() must not recurse
+	keys.resize(100000);
+	insertAndTeardown<Unbalanced, HeapNodeAllocator>("unbalanced heap, degenerate", keys);
+	insertAndTeardown<Unbalanced, ArenaNodeAllocator>("unbalanced arena, degenerate", keys);
+}
+
+void benchFreeze() {
+	const size_t count = 4000000;
+	const size_t lookups = 10000000;
+	mt19937 random(3);
+	BinaryTree<int, int, AVLBalanced, ArenaNodeAllocator> tree;
+	vector<int> keys(count);
+	for (int& key : keys) {
+		key = random();
+		tree.insert(key, key);
+	}
+	FrozenTree<int, int> frozen = tree.freeze();
+	vector<int> queries(lookups);
+	for (int& query : queries) {
+		query = keys[random() % count];
+	}
+	long long sum = 0;
+	Clock::time_point start = Clock::now();
+	for (int query : queries) {
+		sum += (*tree.find(query)).second;
+	}
+	double treeFind = millisecondsSince(start);
+	start = Clock::now();
+	for (int query : queries) {
+		sum += frozen.find(query)->second;
+	}
+	double frozenFind = millisecondsSince(start);
+	printf("%zu keys, %zu successful finds\n", count, lookups);
+	printf("BinaryTree<AVLBalanced, ArenaNodeAllocator>::find %6.1f Mops/s\n", lookups / treeFind / 1e3);
+	printf("FrozenTree::find                                  %6.1f Mops/s  (%lld)\n", lookups / frozenFind / 1e3, sum);
+}
+
+void benchConcurrent() {
+	const int range = 1000003;
+	ConcurrentBinaryTree<int, int> tree;
+	for (int i = 0; i < 1000000; ++i) {
+		tree.insert(i * 7 % range, i);
+	}
+	//past the cores the readers contend for them, at least 32 to show the reader slots under oversubscription
+	int mostReaders = max(32, static_cast<int>(thread::hardware_concurrency()));
+	for (int readers = 1; readers <= mostReaders; readers *= 2) {
+		atomic<bool> done{ false };
+		atomic<long long> reads{ 0 };
+		vector<thread> threads;
+		for (int reader = 0; reader < readers; ++reader) {
+			threads.emplace_back([&tree, &done, &reads, range, reader] {
+				mt19937 random(reader);
+				long long count = 0;
+				int value;
+				while (!done) {
+					for (int i = 0; i < 256; ++i) {
+						tree.find(random() % range, value);
+					}
+					count += 256;
+				}
+				reads += count;
+			});
+		}
+		threads.emplace_back([&tree, &done, range] {
+			mt19937 random(5);
+			while (!done) {
+				int key = random() % range;
+				tree.insert(key, 1);
+				tree.erase(key);
+			}
+		});
+		this_thread::sleep_for(chrono::seconds(1));
+		done = true;
+		for (thread& worker : threads) {
+			worker.join();
+		}
+		printf("%d readers + 1 writer: %6.2f M reads/s\n", readers, reads / 1e6);
+	}
+}
+
+//the node as it was before the key was stored only once: a copy of the key in front of the key-value pair
+template<typename KeyType, typename ValueType>
+struct PreviousNode {
+	KeyType key_;
+	pair<KeyType, ValueType> value_;
+	PreviousNode* left_;
+	PreviousNode* right_;
+	PreviousNode* parent_;
+};
+
+//inserts every key into an empty tree, then all of them once more, insert gets the key by value
+template<typename Insert>
+void insertStrings(const char* name, const vector<string>& keys, Insert insert) {
+	BinaryTree<string, int, AVLBalanced> tree;
+	Clock::time_point start = Clock::now();
+	for (size_t i = 0; i < keys.size(); ++i) {
+		insert(tree, keys[i], static_cast<int>(i));
+	}
+	double fresh = millisecondsSince(start);
+	start = Clock::now();
+	for (size_t i = 0; i < keys.size(); ++i) {
+		insert(tree, keys[i], static_cast<int>(i));
+	}
+	double again = millisecondsSince(start);
+	printf("%-24s new keys %5.2f M inserts/s  keys in the tree %5.2f M inserts/s  (%zu elements)\n", name,
+		keys.size() / fresh / 1e3, keys.size() / again / 1e3, tree.size());
+}
+
+void benchNode() {
+	typedef BinaryTree<int, int>::TreeNode IntNode;
+	typedef BinaryTree<string, int>::TreeNode StringNode;
+	mt19937 random(3);
+	vector<string> keys(1000000);
+	for (string& key : keys) {
+		for (int i = 0; i < 24; ++i) {
+			key += static_cast<char>('a' + random() % 26);
+		}
+	}
+	//a key too long for the small string buffer has its characters on the heap, once for every copy of it
+	size_t characters = keys[0].capacity() + 1;
+	printf("int keys and values         : before %3zu bytes per node  after %3zu\n", sizeof(PreviousNode<int, int>), sizeof(IntNode));
+	printf("24 character keys, int value: before %3zu bytes per node  after %3zu\n",
+		sizeof(PreviousNode<string, int>) + 2 * characters, sizeof(StringNode) + characters);
+	insertStrings("insert(key, value)", keys, [](BinaryTree<string, int, AVLBalanced>& tree, string key, int value) {
+		tree.insert(move(key), value);
+	});
+	insertStrings("insert(value_type&&)", keys, [](BinaryTree<string, int, AVLBalanced>& tree, string key, int value) {
+		tree.insert(make_pair(move(key), value));
+	});
+	insertStrings("emplace(key, value)", keys, [](BinaryTree<string, int, AVLBalanced>& tree, string key, int value) {
+		tree.emplace(move(key), value);
+	});
+	insertStrings("try_emplace(key, value)", keys, [](BinaryTree<string, int, AVLBalanced>& tree, string key, int value) {
+		tree.try_emplace(move(key), value);
+	});
+}
+
+void benchMapped() {
+	const int count = 5000000;
+	const char* dumpPath = "BinaryTree_Bench.txt";
+	const char* mapPath = "BinaryTree_Bench.map";
+	{
+		mt19937_64 random(1);
+		ofstream dump(dumpPath);
+		BinaryTree<long long, long long, AVLBalanced, ArenaNodeAllocator> tree;
+		for (int i = 0; i < count; ++i) {
+			long long key = random();
+			long long value = random();
+			dump << key << ' ' << value << '\n';
+			tree.insert(key, value);
+		}
+		MappedTree<long long, long long>::save(tree.freeze(), mapPath);
+	}
+	Clock::time_point start = Clock::now();
+	{
+		ifstream dump(dumpPath);
+		BinaryTree<long long, long long, AVLBalanced, ArenaNodeAllocator> tree;
+		long long key;
+		long long value;
+		while (dump >> key >> value) {
+			tree.insert(key, value);
+		}
+		printf("parse text dump + insert (AVL, arena): %9.2f ms  (%zu)\n", millisecondsSince(start), tree.size());
+	}
+	start = Clock::now();
+	{
+		MappedTree<long long, long long> tree(mapPath);
+		tree.find(5);
+		printf("MappedTree open with checksum         : %9.2f ms  (%zu)\n", millisecondsSince(start), tree.size());
+	}
+	start = Clock::now();
+	{
+		MappedTree<long long, long long> tree(mapPath, false);
+		tree.find(5);
+		printf("MappedTree open without checksum      : %9.2f ms  (%zu)\n", millisecondsSince(start), tree.size());
+	}
+	remove(dumpPath);
+	remove(mapPath);
+}
+
+//the keys 0 to count - 1 with equal values, the sorted elements are freed before the benchmark runs
+BinaryTree<int, long long, AVLBalanced, ArenaNodeAllocator> sortedTree(size_t count) {
+	vector<pair<int, long long>> sorted;
+	sorted.reserve(count);
+	for (size_t i = 0; i < count; ++i) {
+		sorted.emplace_back(static_cast<int>(i), i);
+	}
+	return BinaryTree<int, long long, AVLBalanced, ArenaNodeAllocator>::build_from_sorted(sorted.begin(), sorted.end());
+}
+
+void benchParallel(size_t count) {
+	auto tree = sortedTree(count);
+	auto reduce = [](long long sum, const pair<const int, long long>& element) {
+		return sum + element.second;
+	};
+	auto combine = [](long long left, long long right) {
+		return left + right;
+	};
+	size_t cores = max(1u, thread::hardware_concurrency());
+	for (size_t workers = 1;; workers = min(2 * workers, cores)) {
+		WorkStealingPool pool(workers);
+		Clock::time_point start = Clock::now();
+		long long sum = tree.parallel_reduce(0LL, reduce, combine, pool);
+		printf("parallel_reduce, %3zu workers: %8.2f ms  (%lld)\n", workers, millisecondsSince(start), sum);
+		if (workers == cores) {
+			break;
+		}
+	}
+	Clock::time_point start = Clock::now();
+	long long sum = 0;
+	for (auto it = tree.begin(); it != tree.end(); ++it) {
+		sum += (*it).second;
+	}
+	printf("iterator loop               : %8.2f ms  (%lld)\n", millisecondsSince(start), sum);
+}
+
+int main(int argc, char* argv[]) {
+	const char* benchmark = argc > 1 ? argv[1] : "";
+	if (strcmp(benchmark, "allocator") == 0) {
+		benchAllocator();
+	}
+	else if (strcmp(benchmark, "freeze") == 0) {
+		benchFreeze();
+	}
+	else if (strcmp(benchmark, "concurrent") == 0) {
+		benchConcurrent();
+	}
+	else if (strcmp(benchmark, "mapped") == 0) {
+		benchMapped();
+	}
+	else if (strcmp(benchmark, "node") == 0) {
+		benchNode();
+	}
+	else if (strcmp(benchmark, "parallel") == 0) {
+		benchParallel(argc > 2 ? strtoull(argv[2], nullptr, 10) : 4000000);
+	}
+	else {
+		fprintf(stderr, "usage: %s allocator|freeze|concurrent|mapped|node|parallel [count]\n", argv[0]);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,441 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "BinaryTree.h"
+#include "ConcurrentBinaryTree.h"
+
+using namespace std;
+using namespace CustomBinaryTree;
+
+/*
+Checks of BinaryTree, exits with 1 on the first failure
+	BinaryTree_Test [count]
+Inserts count (10M by default) sorted keys into an AVL tree, which would make an unbalanced tree a list,
+and checks the height against the AVL bound 1.44*log2(n+2) and the keys coming out in order.
+The other checks compare the trees with the standard containers on random operations.
+*/
+bool check(bool condition, const char* what) {
+	if (!condition) {
+		fprintf(stderr, "FAILED: %s\n", what);
+	}
+	return condition;
+}
+
+typedef vector<pair<int, int>> Elements;
+
+//the elements in the order the iterators visit them, the iterators climb the parent pointers to get from a subtree to the next
+template<typename Tree>
+Elements contents(Tree& tree) {
+	Elements elements;
+	for (auto it = tree.begin(); it != tree.end(); ++it) {
+		elements.emplace_back((*it).first, (*it).second);
+	}
+	return elements;
+}
+
+//AVL bound on the height of a tree of count nodes
+bool withinAVLBound(size_t height, size_t count) {
+	return height <= 1.4405 * log2(count + 2.0) - 0.3277;
+}
+
+bool sortedInsertHeight(int count) {
+	BinaryTree<int, int, AVLBalanced> tree;
+	for (int key = 0; key < count; ++key) {
+		tree.insert(key, key);
+	}
+	double bound = 1.4405 * log2(count + 2.0) - 0.3277;
+	size_t height = tree.height();
+	printf("%d sorted keys: height %zu, AVL bound %.1f\n", count, height, bound);
+	int expected = 0;
+	for (auto it = tree.begin(); it != tree.end(); ++it) {
+		if ((*it).first != expected++) {
+			return check(false, "keys in order");
+		}
+	}
+	return check(expected == count, "every key in the tree") && check(height <= bound, "height within the AVL bound");
+}
+
+/*
+build_from_sorted of 0 to 300 elements with runs of equal keys: the in order output is the input, the tree is perfectly balanced,
+and inserts and erases afterwards, which walk the parent pointers and the AVL heights set by the build, keep it an AVL tree
+*/
+bool buildFromSorted() {
+	mt19937 random(4);
+	for (int count = 0; count <= 300; ++count) {
+		Elements sorted;
+		int key = 0;
+		for (int i = 0; i < count; ++i) {
+			key += random() % 3;
+			sorted.emplace_back(key, i);
+		}
+		auto tree = BinaryTree<int, int, AVLBalanced>::build_from_sorted(sorted.begin(), sorted.end());
+		size_t perfect = 0;
+		while ((size_t(1) << perfect) < size_t(count) + 1) {
+			++perfect;
+		}
+		if (!check(tree.size() == size_t(count) && contents(tree) == sorted, "build_from_sorted keeps the elements in order") ||
+			!check(tree.height() == perfect, "build_from_sorted builds a perfectly balanced tree")) {
+			return false;
+		}
+		multimap<int, int> expected(sorted.begin(), sorted.end());
+		for (int i = 0; i < 100; ++i) {
+			int changed = random() % (key + 2);
+			if (random() % 2 == 0) {
+				tree.insert(changed, count + i);
+				expected.emplace(changed, count + i);
+			}
+			else {
+				//one of the equal keys, the one find returns
+				auto it = tree.find(changed);
+				if (it != tree.end()) {
+					auto same = expected.find(changed);
+					while (same->second != (*it).second) {
+						++same;
+					}
+					expected.erase(same);
+					tree.erase(it);
+				}
+			}
+		}
+		if (!check(contents(tree) == Elements(expected.begin(), expected.end()), "inserts and erases after build_from_sorted") ||
+			!check(withinAVLBound(tree.height(), tree.size()), "the tree stays within the AVL bound after build_from_sorted")) {
+			return false;
+		}
+	}
+	Elements none;
+	auto empty = BinaryTree<int, int, AVLBalanced>::build_from_sorted(none.begin(), none.end());
+	return check(empty.empty() && empty.begin() == empty.end(), "build_from_sorted of an empty range");
+}
+
+/*
+insert_batch gives the same elements in the same order as inserting them one by one, equal keys included:
+batches of every size from empty ones, which are inserted one by one, to ones larger than the tree, which are merged and relinked
+*/
+bool insertBatch() {
+	mt19937 random(5);
+	for (int round = 0; round < 300; ++round) {
+		BinaryTree<int, int, AVLBalanced> batched;
+		BinaryTree<int, int, AVLBalanced> single;
+		int range = 1 + random() % 200;
+		int count = random() % 300;
+		for (int i = 0; i < count; ++i) {
+			int key = random() % range;
+			batched.insert(key, i);
+			single.insert(key, i);
+		}
+		Elements batch(round % 10 == 0 ? 0 : random() % 400);
+		for (size_t i = 0; i < batch.size(); ++i) {
+			batch[i] = make_pair(int(random() % range), count + int(i));
+		}
+		batched.insert_batch(batch.begin(), batch.end());
+		for (const pair<int, int>& element : batch) {
+			single.insert(element.first, element.second);
+		}
+		if (!check(batched.size() == single.size() && contents(batched) == contents(single), "insert_batch inserts like single inserts") ||
+			!check(withinAVLBound(batched.height(), batched.size()), "the tree stays within the AVL bound after insert_batch")) {
+			return false;
+		}
+	}
+	return true;
+}
+
+//counts every construction, copy and move of the key and value objects in the in-place insertion checks
+struct Counted {
+	static int constructions;
+	static int copies;
+	static int moves;
+	static void reset() {
+		constructions = copies = moves = 0;
+	}
+	explicit Counted(int id) :id_{ id } {
+		++constructions;
+	}
+	Counted(const Counted& that) :id_{ that.id_ } {
+		++copies;
+	}
+	Counted(Counted&& that) :id_{ that.id_ } {
+		++moves;
+	}
+	bool operator <(const Counted& that) const {
+		return id_ < that.id_;
+	}
+	int id_;
+};
+int Counted::constructions = 0;
+int Counted::copies = 0;
+int Counted::moves = 0;
+
+/*
+emplace builds the element in the node, so the key is made once and never copied (the node used to keep a copy of it
+besides the pair), try_emplace of a key already in the tree neither constructs, copies nor moves anything
+and find takes a key of another type, as a std::string_view for std::string keys
+*/
+bool inPlaceInsertion() {
+	BinaryTree<Counted, Counted, AVLBalanced> tree;
+	Counted::reset();
+	tree.emplace(piecewise_construct, forward_as_tuple(5), forward_as_tuple(50));
+	if (!check(Counted::constructions == 2 && Counted::copies == 0 && Counted::moves == 0, "piecewise emplace constructs the key and the value once")) {
+		return false;
+	}
+	Counted::reset();
+	tree.emplace(Counted(7), Counted(70));
+	if (!check(Counted::copies == 0 && Counted::moves == 2, "emplace moves the key once and never copies it")) {
+		return false;
+	}
+	Counted key(5);
+	Counted::reset();
+	auto existing = tree.try_emplace(move(key), 51);
+	if (!check(!existing.second && (*existing.first).second.id_ == 50 && key.id_ == 5, "try_emplace of a key in the tree keeps its element") ||
+		!check(Counted::constructions == 0 && Counted::copies == 0 && Counted::moves == 0, "try_emplace of a key in the tree constructs and moves nothing")) {
+		return false;
+	}
+	Counted::reset();
+	auto inserted = tree.try_emplace(Counted(6), 60);
+	if (!check(inserted.second && (*inserted.first).second.id_ == 60 && tree.size() == 3, "try_emplace of a new key inserts it") ||
+		!check(Counted::constructions == 2 && Counted::copies == 0 && Counted::moves == 1, "try_emplace moves the key in and constructs the value in place")) {
+		return false;
+	}
+	BinaryTree<string, int> names;
+	names.insert("a key longer than the small string buffer", 1);
+	names.insert(make_pair(string("b"), 2));
+	names.try_emplace("c", 3);
+	string_view view = "a key longer than the small string buffer, cut";
+	return check(names.find(view.substr(0, 41)) != names.end() && (*names.find(view.substr(0, 41))).second == 1, "find with a std::string_view") &&
+		check(names.find(view) == names.end() && names.find(string_view("c")) != names.end(), "find with a std::string_view of a missing and a short key") &&
+		check(names.find("b") != names.end() && (*names.find("b")).second == 2, "find with a C string");
+}
+
+/*
+rank, select, count_range, lower_bound and upper_bound against a std::multiset after every random insert or erase,
+erases by key and by the iterator select returns, so the subtree sizes are kept up through rotations and transplants.
+The queried keys run one past both ends of the key range, k runs up to size and the ranges include a == b and a > b
+*/
+template<typename Tree>
+bool orderStatistics(unsigned seed) {
+	mt19937 random(seed);
+	for (int round = 0; round < 20; ++round) {
+		Tree tree;
+		multiset<int> expected;
+		int range = 1 + random() % 200;
+		for (int op = 0; op < 600; ++op) {
+			int key = random() % range;
+			unsigned choice = random() % 5;
+			if (choice < 3 || expected.empty()) {
+				tree.insert(key, op);
+				expected.insert(key);
+			}
+			else if (choice == 3) {
+				if (expected.count(key) > 0) {
+					tree.erase(key);
+					expected.erase(expected.find(key));
+				}
+			}
+			else {
+				size_t k = random() % expected.size();
+				auto selected = tree.select(k);
+				auto nth = next(expected.begin(), k);
+				if (!check(selected != tree.end() && (*selected).first == *nth, "select before erasing it")) {
+					return false;
+				}
+				tree.erase(selected);
+				expected.erase(nth);
+			}
+			if (!check(tree.size() == expected.size(), "size")) {
+				return false;
+			}
+			int a = static_cast<int>(random() % (range + 2)) - 1;
+			int b = static_cast<int>(random() % (range + 2)) - 1;
+			auto lower = tree.lower_bound(a);
+			auto upper = tree.upper_bound(a);
+			auto expectedLower = expected.lower_bound(a);
+			auto expectedUpper = expected.upper_bound(a);
+			if (!check(tree.rank(a) == size_t(distance(expected.begin(), expectedLower)), "rank") ||
+				!check(lower == tree.end() ? expectedLower == expected.end() : expectedLower != expected.end() && (*lower).first == *expectedLower, "lower_bound") ||
+				!check(upper == tree.end() ? expectedUpper == expected.end() : expectedUpper != expected.end() && (*upper).first == *expectedUpper, "upper_bound") ||
+				!check(tree.count_range(a, b) == (a < b ? size_t(distance(expectedLower, expected.lower_bound(b))) : 0), "count_range") ||
+				!check(tree.count_range(a, a) == 0, "count_range of an empty range")) {
+				return false;
+			}
+		}
+		size_t k = 0;
+		for (int key : expected) {
+			auto selected = tree.select(k++);
+			if (!check(selected != tree.end() && (*selected).first == key, "select of every rank")) {
+				return false;
+			}
+		}
+		if (!check(tree.select(expected.size()) == tree.end() && tree.select(expected.size() + 1) == tree.end(), "select past the last rank is end")) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+parallel_for_each calls the function once for every element and may change the values, a worker walks a subtree in order:
+the keys go to the threads in a few hundred runs of consecutive keys visited one after the other, not one by one
+(a run breaks where the next key is on another thread or came first, at the nodes between the subtrees). parallel_reduce with a combine which isn't commutative (appending) gives the keys in order
+*/
+template<typename Tree>
+bool parallelVisits(Tree& tree, int count, WorkStealingPool& pool) {
+	vector<atomic<int>> visits(count);
+	vector<int> sequence(count);
+	vector<thread::id> threads(count);
+	atomic<int> next{ 0 };
+	tree.parallel_for_each([&visits, &sequence, &threads, &next](pair<const int, int>& element) {
+		if (visits[element.first]++ == 0) {
+			sequence[element.first] = next++;
+			threads[element.first] = this_thread::get_id();
+		}
+		++element.second;
+	}, pool);
+	bool once = true;
+	int breaks = 0;
+	for (int key = 0; key < count; ++key) {
+		once &= visits[key] == 1;
+		if (key + 1 < count && (threads[key] != threads[key + 1] || sequence[key + 1] < sequence[key])) {
+			++breaks;
+		}
+	}
+	Elements elements = contents(tree);
+	bool modified = elements.size() == size_t(count);
+	for (int key = 0; key < count && modified; ++key) {
+		modified = elements[key].first == key && elements[key].second == key + 1;
+	}
+	vector<int> keys = tree.parallel_reduce(vector<int>(), [](vector<int> keys, const pair<const int, int>& element) {
+		keys.push_back(element.first);
+		return keys;
+	}, [](vector<int> left, vector<int> right) {
+		left.insert(left.end(), right.begin(), right.end());
+		return left;
+	}, pool);
+	bool inOrder = keys.size() == size_t(count);
+	for (int key = 0; key < count && inOrder; ++key) {
+		inOrder = keys[key] == key;
+	}
+	return check(once, "parallel_for_each visits every element once") && check(modified, "parallel_for_each changes the values") &&
+		check(breaks <= 512, "the workers visit runs of consecutive keys in order") &&
+		check(inOrder, "parallel_reduce appends the keys in order");
+}
+
+bool parallelTraversal() {
+	const int count = 100000;
+	vector<pair<int, int>> sorted;
+	for (int key = 0; key < count; ++key) {
+		sorted.emplace_back(key, key);
+	}
+	vector<int> shuffled(count);
+	for (int key = 0; key < count; ++key) {
+		shuffled[key] = key;
+	}
+	shuffle(shuffled.begin(), shuffled.end(), mt19937(13));
+	for (size_t workers : { 1, 2, 4 }) {
+		WorkStealingPool pool(workers);
+		auto balanced = BinaryTree<int, int, AVLBalanced>::build_from_sorted(sorted.begin(), sorted.end());
+		BinaryTree<int, int> random;
+		for (int key : shuffled) {
+			random.insert(key, key);
+		}
+		//a list can't be split, it runs on one thread
+		BinaryTree<int, int> degenerate;
+		for (int key = 0; key < 2000; ++key) {
+			degenerate.insert(key, key);
+		}
+		BinaryTree<int, int> empty;
+		if (!parallelVisits(balanced, count, pool) || !parallelVisits(random, count, pool) || !parallelVisits(degenerate, 2000, pool) ||
+			!parallelVisits(empty, 0, pool)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+One writer inserts and erases random keys of a ConcurrentBinaryTree while readers look keys up and walk snapshots:
+a found key has the value the writer gives it, every snapshot is in strictly increasing key order (the writer never
+inserts a key twice) and finds every key it walks. The final contents are those of a std::map the writer kept alongside
+*/
+bool concurrentStress(size_t readers) {
+	const int range = 2000;
+	const int writes = 100000;
+	ConcurrentBinaryTree<int, int> tree;
+	atomic<bool> done{ false };
+	atomic<int> failures{ 0 };
+	vector<thread> threads;
+	for (size_t reader = 0; reader < readers; ++reader) {
+		threads.emplace_back([&tree, &done, &failures, reader] {
+			mt19937 random(static_cast<unsigned>(reader));
+			while (!done) {
+				for (int i = 0; i < 100; ++i) {
+					int key = random() % range;
+					int value;
+					if (tree.find(key, value) && value != key * 7) {
+						++failures;
+					}
+				}
+				auto view = tree.read();
+				int previous = -1;
+				view.for_each([&view, &failures, &previous](const pair<int, int>& element) {
+					if (element.first <= previous || element.second != element.first * 7 || view.find(element.first) != &element) {
+						++failures;
+					}
+					previous = element.first;
+				});
+			}
+		});
+	}
+	map<int, int> expected;
+	mt19937 random(11);
+	for (int i = 0; i < writes; ++i) {
+		int key = random() % range;
+		if (expected.count(key) == 0) {
+			tree.insert(key, key * 7);
+			expected[key] = key * 7;
+		}
+		else if (!tree.erase(key) || expected.erase(key) != 1) {
+			++failures;
+		}
+	}
+	done = true;
+	for (thread& reader : threads) {
+		reader.join();
+	}
+	Elements elements;
+	tree.read().for_each([&elements](const pair<int, int>& element) {
+		elements.push_back(element);
+	});
+	return check(failures == 0, "readers see consistent snapshots while the writer runs") &&
+		check(tree.size() == expected.size() && elements == Elements(expected.begin(), expected.end()), "the final contents match a std::map");
+}
+
+int main(int argc, char* argv[]) {
+	int count = argc > 1 ? atoi(argv[1]) : 10000000;
+	if (!buildFromSorted() || !insertBatch() || !concurrentStress(8)) {
+		return 1;
+	}
+	if (!inPlaceInsertion() || !parallelTraversal()) {
+		return 1;
+	}
+	if (!orderStatistics<BinaryTree<int, int, Unbalanced, HeapNodeAllocator, SubtreeSize>>(5) ||
+		!orderStatistics<BinaryTree<int, int, AVLBalanced, HeapNodeAllocator, SubtreeSize>>(6) ||
+		!orderStatistics<BinaryTree<int, int, AVLBalanced, ArenaNodeAllocator, SubtreeSize>>(7)) {
+		return 1;
+	}
+	if (!sortedInsertHeight(count)) {
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
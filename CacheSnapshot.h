@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//Entry of a cache as saved, ttl is the time it had left (in clock ticks) or 0 if it never expires
+struct CacheEntry {
+	int isbn;
+	int price;
+	uint64_t ttl;
+};
+
+/*
+Binary file with the entries of a cache, in the order they were saved (native byte order)
+	header  : magic "LRUCACHE", format version, entry count
+	entries : count CacheEntry records
+*/
+class CacheSnapshot {
+public:
+	static constexpr uint32_t formatVersion = 1;
+
+	//Writes the entries to the file at path, replacing it. Throws if the file can't be written
+	static void write(const vector<CacheEntry>& entries, const string& path) {
+		Header header = {};
+		memcpy(header.magic_, magic, sizeof(header.magic_));
+		header.version_ = formatVersion;
+		header.count_ = entries.size();
+		ofstream file(path, ios::binary | ios::trunc);
+		if (!file) {
+			throw("Cannot open the file for writing");
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(CacheEntry));
+		if (!file.flush()) {
+			throw("Cannot write the file");
+		}
+	}
+
+	//Reads the entries from the file at path. Throws if it can't be read or isn't a cache snapshot
+	static vector<CacheEntry> read(const string& path) {
+		ifstream file(path, ios::binary);
+		if (!file) {
+			throw("Cannot open the file");
+		}
+		Header header;
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+			memcmp(header.magic_, magic, sizeof(header.magic_)) != 0 || header.version_ != formatVersion) {
+			throw("Not a cache snapshot file");
+		}
+		//the size has to match before the count is trusted for the allocation,
+		//the count is bounded by the size first so that a forged one can't overflow the product
+		file.seekg(0, ios::end);
+		uint64_t size = static_cast<uint64_t>(file.tellg());
+		if (header.count_ > (size - sizeof(Header)) / sizeof(CacheEntry) || size != sizeof(Header) + header.count_ * sizeof(CacheEntry)) {
+			throw("Cache snapshot file is truncated");
+		}
+		file.seekg(sizeof(Header));
+		vector<CacheEntry> entries(static_cast<size_t>(header.count_));
+		if (!file.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(CacheEntry))) {
+			throw("Cannot read the file");
+		}
+		return entries;
+	}
+private:
+	struct Header {
+		char magic_[8];
+		uint32_t version_;
+		uint32_t reserved_;
+		uint64_t count_;
+	};
+	static constexpr char magic[8] = { 'L', 'R', 'U', 'C', 'A', 'C', 'H', 'E' };
+};
@@ -0,0 +1,117 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+/*
+Histogram of latencies in nanoseconds, bucket b counts the latencies in [2^(b-1), 2^b)
+Recording is a count leading zeros and an increment, percentiles are accurate to a factor of 2.
+*/
+class LatencyHistogram {
+public:
+	static constexpr size_t bucketCount = 64;
+
+	void record(uint64_t nanoseconds) {
+		++buckets_[bucket(nanoseconds)];
+		++count_;
+	}
+	uint64_t count() const {
+		return count_;
+	}
+	uint64_t bucketSize(size_t bucket) const {
+		return buckets_[bucket];
+	}
+	//upper bound of the latency below which the given fraction (0 to 1) of the recorded latencies are
+	uint64_t percentile(double fraction) const {
+		uint64_t wanted = static_cast<uint64_t>(fraction * count_);
+		uint64_t seen = 0;
+		for (size_t b = 0; b < bucketCount; ++b) {
+			seen += buckets_[b];
+			if (seen > wanted || seen == count_) {
+				return b == 0 ? 0 : b >= 63 ? ~uint64_t(0) : (uint64_t(1) << b) - 1;
+			}
+		}
+		return 0;
+	}
+	LatencyHistogram& operator+=(const LatencyHistogram& other) {
+		for (size_t b = 0; b < bucketCount; ++b) {
+			buckets_[b] += other.buckets_[b];
+		}
+		count_ += other.count_;
+		return *this;
+	}
+private:
+	array<uint64_t, bucketCount> buckets_ = {};
+	uint64_t count_ = 0;
+
+	static size_t bucket(uint64_t nanoseconds) {
+		if (nanoseconds == 0) {
+			return 0;
+		}
+#if defined(_MSC_VER)
+		unsigned long position;
+		_BitScanReverse64(&position, nanoseconds);
+		return min<size_t>(position + 1, bucketCount - 1);
+#else
+		return min<size_t>(64 - __builtin_clzll(nanoseconds), bucketCount - 1);
+#endif
+	}
+};
+
+//Records the time from its construction to its destruction
+class LatencyTimer {
+public:
+	explicit LatencyTimer(LatencyHistogram& histogram) :histogram_{ histogram }, start_{ chrono::steady_clock::now() }
+	{}
+	LatencyTimer(const LatencyTimer& other) = delete;
+	LatencyTimer& operator=(const LatencyTimer& other) = delete;
+	~LatencyTimer() {
+		histogram_.record(static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+			chrono::steady_clock::now() - start_).count()));
+	}
+private:
+	LatencyHistogram& histogram_;
+	chrono::steady_clock::time_point start_;
+};
+
+/*
+Counters of a cache, kept by the cache itself with plain increments
+The lookup latency histogram reads the clock twice per lookup, it is only compiled in
+when LRU_CACHE_LATENCY is defined (the same way in every file including the cache).
+*/
+struct CacheStats {
+	//lookups which found the isbn
+	uint64_t hits = 0;
+	//lookups which didn't
+	uint64_t misses = 0;
+	//isbns added to the cache, not counting inserts of isbns which were in it already
+	uint64_t inserts = 0;
+	//entries removed to make room
+	uint64_t evictions = 0;
+	//entries removed because their time to live was over
+	uint64_t expirations = 0;
+#if defined(LRU_CACHE_LATENCY)
+	LatencyHistogram lookupLatency;
+#endif
+
+	double hitRatio() const {
+		return hits + misses == 0 ? 0 : static_cast<double>(hits) / (hits + misses);
+	}
+	CacheStats& operator+=(const CacheStats& other) {
+		hits += other.hits;
+		misses += other.misses;
+		inserts += other.inserts;
+		evictions += other.evictions;
+		expirations += other.expirations;
+#if defined(LRU_CACHE_LATENCY)
+		lookupLatency += other.lookupLatency;
+#endif
+		return *this;
+	}
+};
@@ -0,0 +1,381 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace CustomBinaryTree {
+	/*
+	Node of the ConcurrentBinaryTree
+	Once a node is published (reachable from the root) it is never modified again, so readers
+	need no synchronization beyond loading the root. version_ tells the writer which nodes it created
+	during the current write, only those may still be modified in place.
+	*/
+	template<typename KeyType, typename ValueType>
+	struct ConcurrentNode {
+		std::pair<KeyType, ValueType> value_;
+		ConcurrentNode* left_;
+		ConcurrentNode* right_;
+		int height_;
+		uint64_t version_;
+		ConcurrentNode(const std::pair<KeyType, ValueType>& value, ConcurrentNode* left, ConcurrentNode* right, uint64_t version)
+			:value_{ value }, left_{ left }, right_{ right }, height_{ 1 }, version_{ version }
+		{}
+	};
+
+	/*
+	AVL tree shared between many reader threads and writers, readers never block and never wait for a writer.
+	Writers don't modify published nodes, they copy the path from the root to the change (path copying),
+	rebalance the copies and publish the new root with a single atomic store. A reader loads the root once
+	and sees a consistent snapshot of the whole tree for as long as it keeps reading.
+	Writers are serialized by a mutex, they cost O(log(n)) node copies each.
+
+	Nodes replaced by a write can't be freed right away as readers may still be walking them,
+	they are reclaimed with epochs: a reader announces the global epoch in a slot while it reads,
+	a replaced node is tagged with the epoch it was replaced in and is freed once every reader
+	announced a later epoch or is idle. A reader which stalls only delays reclamation, never the writers.
+	At most maxReaders threads can be reading at the same time, further readers spin until a slot frees up.
+	*/
+	template<typename KeyType, typename ValueType>
+	class ConcurrentBinaryTree {
+	public:
+		using TreeNode = ConcurrentNode<KeyType, ValueType>;
+		static constexpr size_t maxReaders = 128;
+
+		ConcurrentBinaryTree() = default;
+		//shared between threads, neither copied nor moved
+		ConcurrentBinaryTree(const ConcurrentBinaryTree& tree) = delete;
+		ConcurrentBinaryTree& operator=(const ConcurrentBinaryTree& tree) = delete;
+		//no reader or writer may be active anymore
+		~ConcurrentBinaryTree() {
+			destroy(root_.load());
+			for (const Retired& retired : retired_) {
+				delete retired.second;
+			}
+		}
+
+		/*
+		Pinned view of the tree as it was when the snapshot was taken
+		Nodes of the snapshot stay alive until it is destroyed, so pointers returned by find are valid until then.
+		Holding a snapshot for long keeps every node replaced since then in memory.
+		*/
+		class snapshot {
+		public:
+			explicit snapshot(const ConcurrentBinaryTree& tree) :tree_{ tree }, slot_{ tree.pin() }
+			{
+				root_ = tree.root_.load();
+			}
+			snapshot(const snapshot& other) = delete;
+			snapshot& operator=(const snapshot& other) = delete;
+			~snapshot() {
+				tree_.unpin(slot_);
+			}
+
+			//Returns: The element with the given key or nullptr if there is none
+			const std::pair<KeyType, ValueType>* find(const KeyType& key) const {
+				const TreeNode* node = root_;
+				while (node != nullptr) {
+					if (key < node->value_.first) {
+						node = node->left_;
+					}
+					else if (node->value_.first < key) {
+						node = node->right_;
+					}
+					else {
+						return &node->value_;
+					}
+				}
+				return nullptr;
+			}
+
+			//Calls function with every element in order
+			template<typename Function>
+			void for_each(Function function) const {
+				std::vector<const TreeNode*> pending;
+				const TreeNode* node = root_;
+				while (node != nullptr || !pending.empty()) {
+					while (node != nullptr) {
+						pending.push_back(node);
+						node = node->left_;
+					}
+					node = pending.back();
+					pending.pop_back();
+					function(node->value_);
+					node = node->right_;
+				}
+			}
+		private:
+			const ConcurrentBinaryTree& tree_;
+			size_t slot_;
+			const TreeNode* root_;
+		};
+
+		snapshot read() const {
+			return snapshot(*this);
+		}
+
+		/*
+		Copies the value of the element with the given key
+		Returns: true if the key was found
+		*/
+		bool find(const KeyType& key, ValueType& value) const {
+			snapshot view(*this);
+			const std::pair<KeyType, ValueType>* element = view.find(key);
+			if (element == nullptr) {
+				return false;
+			}
+			value = element->second;
+			return true;
+		}
+		bool contains(const KeyType& key) const {
+			snapshot view(*this);
+			return view.find(key) != nullptr;
+		}
+		size_t size() const {
+			return size_.load();
+		}
+
+		//Equal keys are allowed and go after the ones already in the tree, same as BinaryTree
+		void insert(KeyType k, ValueType v) {
+			std::lock_guard<std::mutex> lock(writer_);
+			++version_;
+			TreeNode* root = insert(root_.load(), std::make_pair(k, v));
+			publish(root);
+			++size_;
+		}
+
+		/*
+		Removes one element with the given key
+		Returns: true if there was one
+		*/
+		bool erase(const KeyType& key) {
+			std::lock_guard<std::mutex> lock(writer_);
+			++version_;
+			bool erased = false;
+			TreeNode* root = erase(root_.load(), key, erased);
+			if (erased) {
+				publish(root);
+				--size_;
+			}
+			return erased;
+		}
+	private:
+		//cache line per reader so that readers don't invalidate each other's slots
+		struct alignas(64) ReaderSlot {
+			//epoch the reader announced, 0 when the slot is free
+			std::atomic<uint64_t> epoch_{ 0 };
+		};
+		using Retired = std::pair<uint64_t, TreeNode*>;
+
+		std::atomic<TreeNode*> root_{ nullptr };
+		std::atomic<size_t> size_{ 0 };
+		//starts at 1 as 0 marks a free reader slot
+		std::atomic<uint64_t> epoch_{ 1 };
+		mutable std::array<ReaderSlot, maxReaders> readers_;
+
+		//only touched by the writer holding writer_
+		std::mutex writer_;
+		uint64_t version_ = 0;
+		//nodes replaced by the current write
+		std::vector<TreeNode*> replaced_;
+		//nodes waiting for the readers, in the order of their epochs
+		std::vector<Retired> retired_;
+		static constexpr size_t reclaimBatch = 64;
+
+		/*
+		Claims a reader slot announcing the current epoch, the slot is then the reader's until unpin
+		The claim is sequentially consistent so the root loaded after it is at least as new as the announced epoch
+		*/
+		size_t pin() const {
+			static thread_local size_t hint = std::hash<std::thread::id>()(std::this_thread::get_id());
+			for (size_t attempt = 0;; ++attempt) {
+				size_t index = (hint + attempt) % maxReaders;
+				uint64_t free = 0;
+				if (readers_[index].epoch_.load(std::memory_order_relaxed) == 0 &&
+					readers_[index].epoch_.compare_exchange_strong(free, epoch_.load())) {
+					hint = index;
+					return index;
+				}
+				if (attempt % maxReaders == maxReaders - 1) {
+					std::this_thread::yield();
+				}
+			}
+		}
+		void unpin(size_t slot) const {
+			readers_[slot].epoch_.store(0);
+		}
+
+		//makes the new root visible to readers and retires the nodes it replaced
+		void publish(TreeNode* root) {
+			root_.store(root);
+			uint64_t epoch = epoch_.load();
+			for (TreeNode* node : replaced_) {
+				retired_.emplace_back(epoch, node);
+			}
+			replaced_.clear();
+			epoch_.fetch_add(1);
+			if (retired_.size() >= reclaimBatch) {
+				reclaim();
+			}
+		}
+
+		//frees the retired nodes no reader can reach anymore
+		void reclaim() {
+			uint64_t oldest = std::numeric_limits<uint64_t>::max();
+			for (const ReaderSlot& reader : readers_) {
+				uint64_t epoch = reader.epoch_.load();
+				if (epoch != 0 && epoch < oldest) {
+					oldest = epoch;
+				}
+			}
+			//readers which announced an epoch after the one a node was retired in loaded a root without it
+			auto reachable = std::find_if(retired_.begin(), retired_.end(),
+				[oldest](const Retired& retired) { return retired.first >= oldest; });
+			for (auto it = retired_.begin(); it != reachable; ++it) {
+				delete it->second;
+			}
+			retired_.erase(retired_.begin(), reachable);
+		}
+
+		void destroy(TreeNode* node) {
+			std::vector<TreeNode*> pending;
+			if (node != nullptr) {
+				pending.push_back(node);
+			}
+			while (!pending.empty()) {
+				node = pending.back();
+				pending.pop_back();
+				if (node->left_ != nullptr) {
+					pending.push_back(node->left_);
+				}
+				if (node->right_ != nullptr) {
+					pending.push_back(node->right_);
+				}
+				delete node;
+			}
+		}
+
+		/******** Path copying *******/
+		//returns a node of the current write with the same contents, copying (and retiring) published nodes
+		TreeNode* own(TreeNode* node) {
+			if (node->version_ == version_) {
+				return node;
+			}
+			TreeNode* copy = new TreeNode(node->value_, node->left_, node->right_, version_);
+			copy->height_ = node->height_;
+			replaced_.push_back(node);
+			return copy;
+		}
+
+		TreeNode* insert(TreeNode* node, const std::pair<KeyType, ValueType>& value) {
+			if (node == nullptr) {
+				return new TreeNode(value, nullptr, nullptr, version_);
+			}
+			node = own(node);
+			if (value.first < node->value_.first) {
+				node->left_ = insert(node->left_, value);
+			}
+			else {
+				node->right_ = insert(node->right_, value);
+			}
+			return balance(node);
+		}
+
+		TreeNode* erase(TreeNode* node, const KeyType& key, bool& erased) {
+			if (node == nullptr) {
+				return nullptr;
+			}
+			if (key < node->value_.first) {
+				TreeNode* left = erase(node->left_, key, erased);
+				if (!erased) {
+					return node;
+				}
+				node = own(node);
+				node->left_ = left;
+				return balance(node);
+			}
+			if (node->value_.first < key) {
+				TreeNode* right = erase(node->right_, key, erased);
+				if (!erased) {
+					return node;
+				}
+				node = own(node);
+				node->right_ = right;
+				return balance(node);
+			}
+			erased = true;
+			replaced_.push_back(node);
+			if (node->left_ == nullptr) {
+				return node->right_;
+			}
+			if (node->right_ == nullptr) {
+				return node->left_;
+			}
+			//the successor takes the place of the erased node
+			TreeNode* successor = nullptr;
+			TreeNode* right = eraseMin(node->right_, successor);
+			successor = own(successor);
+			successor->left_ = node->left_;
+			successor->right_ = right;
+			return balance(successor);
+		}
+		//detaches the min node of the subtree, returns the new root of the subtree
+		TreeNode* eraseMin(TreeNode* node, TreeNode*& min) {
+			if (node->left_ == nullptr) {
+				min = node;
+				return node->right_;
+			}
+			node = own(node);
+			node->left_ = eraseMin(node->left_, min);
+			return balance(node);
+		}
+
+		/******** AVL balancing of nodes owned by the current write *******/
+		static int height(const TreeNode* node) {
+			return node == nullptr ? 0 : node->height_;
+		}
+		static void update(TreeNode* node) {
+			node->height_ = 1 + std::max(height(node->left_), height(node->right_));
+		}
+		TreeNode* rotateLeft(TreeNode* node) {
+			TreeNode* right = own(node->right_);
+			node->right_ = right->left_;
+			right->left_ = node;
+			update(node);
+			update(right);
+			return right;
+		}
+		TreeNode* rotateRight(TreeNode* node) {
+			TreeNode* left = own(node->left_);
+			node->left_ = left->right_;
+			left->right_ = node;
+			update(node);
+			update(left);
+			return left;
+		}
+		//node has to be owned by the current write, returns the new root of its subtree
+		TreeNode* balance(TreeNode* node) {
+			update(node);
+			int balance = height(node->left_) - height(node->right_);
+			if (balance > 1) {
+				if (height(node->left_->left_) < height(node->left_->right_)) {
+					node->left_ = rotateLeft(own(node->left_));
+				}
+				return rotateRight(node);
+			}
+			if (balance < -1) {
+				if (height(node->right_->right_) < height(node->right_->left_)) {
+					node->right_ = rotateRight(own(node->right_));
+				}
+				return rotateLeft(node);
+			}
+			return node;
+		}
+	};
+}
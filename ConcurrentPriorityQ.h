@@ -0,0 +1,151 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "MinPriorityQ.h"
+
+/*
+Relaxed concurrent min priority queue (MultiQueue) for many producer and consumer threads
+There are queuesPerThread * threads sequential heaps, each with its own lock, instead of one heap behind a global lock.
+A push goes to a random heap. A pop locks two random heaps and removes the lesser of their two minimums,
+a heap whose lock is taken is skipped for another random one, so threads rarely wait for each other.
+
+Ordering guarantees:
+	- Every pushed element is popped exactly once, none is lost or duplicated.
+	- The order is relaxed: a pop returns the minimum of two heaps, not necessarily the global minimum.
+	  The rank of a popped element among the elements in the queue is O(number of heaps) in expectation
+	  and larger ranks are exponentially unlikely, it doesn't grow with the number of elements.
+	- With a single heap (one thread, one queue per thread) it is an exact priority queue.
+	- tryPop fails only if every heap was seen empty during the call, an element pushed concurrently may be missed.
+	- size() is exact once all threads are done, only a snapshot while they run.
+*/
+template<typename KeyType, size_t Arity = 4, typename compare = std::less<KeyType>>
+class MultiQueue {
+public:
+	explicit MultiQueue(size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency()),
+		size_t queuesPerThread = 2, compare less = compare())
+		:queues_(std::max<size_t>(1, threads * queuesPerThread)), less_{ less }
+	{
+		for (std::unique_ptr<Queue>& queue : queues_) {
+			queue.reset(new Queue(less));
+		}
+	}
+	//shared between threads, neither copied nor moved
+	MultiQueue(const MultiQueue& queue) = delete;
+	MultiQueue& operator=(const MultiQueue& queue) = delete;
+
+	void push(KeyType key) {
+		std::unique_lock<std::mutex> lock;
+		Queue& queue = lockAny(lock);
+		queue.heap_.push(std::move(key));
+		queue.size_.store(queue.heap_.size(), std::memory_order_relaxed);
+	}
+	/*
+	Moves an element which is among the least into key and removes it (see the ordering guarantees above)
+	Returns false, leaving key alone, if the queue was empty
+	*/
+	bool tryPop(KeyType& key) {
+		//random pairs of heaps while some heap looks non empty, then a sweep over all of them before giving up
+		for (size_t attempt = 0; attempt < 2 * queues_.size(); ++attempt) {
+			if (queues_.size() == 1) {
+				break;
+			}
+			size_t first = nextRandom() % queues_.size();
+			size_t second = nextRandom() % (queues_.size() - 1);
+			second += second >= first ? 1 : 0;
+			Queue& a = *queues_[first];
+			Queue& b = *queues_[second];
+			if (a.size_.load(std::memory_order_relaxed) == 0 && b.size_.load(std::memory_order_relaxed) == 0) {
+				continue;
+			}
+			std::unique_lock<std::mutex> lockA(a.mutex_, std::try_to_lock);
+			if (!lockA.owns_lock()) {
+				continue;
+			}
+			std::unique_lock<std::mutex> lockB(b.mutex_, std::try_to_lock);
+			if (!lockB.owns_lock()) {
+				continue;
+			}
+			Queue* least = nullptr;
+			if (!a.heap_.empty()) {
+				least = &a;
+			}
+			if (!b.heap_.empty() && (least == nullptr || less_(b.heap_.min(), least->heap_.min()))) {
+				least = &b;
+			}
+			if (least != nullptr && popLocked(*least, key)) {
+				return true;
+			}
+		}
+		size_t start = nextRandom() % queues_.size();
+		for (size_t i = 0; i < queues_.size(); ++i) {
+			Queue& queue = *queues_[(start + i) % queues_.size()];
+			std::lock_guard<std::mutex> lock(queue.mutex_);
+			if (popLocked(queue, key)) {
+				return true;
+			}
+		}
+		return false;
+	}
+	size_t size() const {
+		size_t total = 0;
+		for (const std::unique_ptr<Queue>& queue : queues_) {
+			total += queue->size_.load(std::memory_order_relaxed);
+		}
+		return total;
+	}
+	bool empty() const {
+		return size() == 0;
+	}
+private:
+	//a cache line each, so the locks of different heaps don't share one
+	struct alignas(64) Queue {
+		explicit Queue(compare less) :heap_(less)
+		{}
+		std::mutex mutex_;
+		dAryMinPriorityQ<KeyType, Arity, compare> heap_;
+		//heap_.size(), readable without the lock to skip empty heaps
+		std::atomic<size_t> size_{ 0 };
+	};
+	std::vector<std::unique_ptr<Queue>> queues_;
+	compare less_;
+
+	//xorshift, one state per thread
+	static size_t nextRandom() {
+		static std::atomic<uint64_t> seeds{ 0x9E3779B97F4A7C15ull };
+		static thread_local uint64_t state = seeds.fetch_add(0x9E3779B97F4A7C15ull) | 1;
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return static_cast<size_t>(state >> 16);
+	}
+	//a random heap whose lock was free, after a round of taken locks waits for one
+	//lock holds the heap's mutex, so it is released even if the caller throws
+	Queue& lockAny(std::unique_lock<std::mutex>& lock) {
+		for (size_t attempt = 0; attempt < queues_.size(); ++attempt) {
+			Queue& queue = *queues_[nextRandom() % queues_.size()];
+			lock = std::unique_lock<std::mutex>(queue.mutex_, std::try_to_lock);
+			if (lock.owns_lock()) {
+				return queue;
+			}
+		}
+		Queue& queue = *queues_[nextRandom() % queues_.size()];
+		lock = std::unique_lock<std::mutex>(queue.mutex_);
+		return queue;
+	}
+	//the heap has to be locked
+	bool popLocked(Queue& queue, KeyType& key) {
+		if (queue.heap_.empty()) {
+			return false;
+		}
+		queue.heap_.pop_n(1, &key);
+		queue.size_.store(queue.heap_.size(), std::memory_order_relaxed);
+		return true;
+	}
+};
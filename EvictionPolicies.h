@@ -0,0 +1,361 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/*
+Eviction policies of LRUCache, each one is a class template on the capacity of the cache with
+	handle insert(int isbn)  starts tracking a key which was just added to the cache
+	void touch(handle h)     the key was found by lookup or inserted again
+	void erase(handle h)     stops tracking a key which was erased from the cache
+	int evict()              called when the cache is full, stops tracking the key to evict and returns it
+	void for_each(f)         calls f(isbn) for every key, roughly in the order they would be evicted (first to last)
+The cache keeps the handle next to the price, a handle stays valid until the key is erased or evicted.
+*/
+
+/*
+Least recently used: keys are kept in recency order, every hit moves its key to the front
+A single scan of keys used only once flushes the whole cache.
+*/
+template<size_t Capacity>
+class LRUEviction {
+public:
+	typedef list<int>::iterator handle;
+
+	handle insert(int isbn) {
+		lru_queue_.emplace_front(isbn);
+		return lru_queue_.begin();
+	}
+	void touch(handle h) {
+		//moves the node, nothing is allocated
+		lru_queue_.splice(lru_queue_.begin(), lru_queue_, h);
+	}
+	void erase(handle h) {
+		lru_queue_.erase(h);
+	}
+	int evict() {
+		int isbn = lru_queue_.back();
+		lru_queue_.pop_back();
+		return isbn;
+	}
+	//least recently used first
+	template<typename Function>
+	void for_each(Function function) const {
+		for (auto it = lru_queue_.rbegin(); it != lru_queue_.rend(); ++it) {
+			function(*it);
+		}
+	}
+private:
+	list<int> lru_queue_;
+};
+
+/*
+CLOCK (second chance): keys sit in a ring of Capacity slots, a hit only sets the referenced bit of its slot
+The hand sweeps the ring clearing referenced bits and evicts the first key which wasn't referenced since the last sweep.
+*/
+template<size_t Capacity>
+class ClockEviction {
+public:
+	typedef size_t handle;
+
+	ClockEviction() :slots_(Capacity)
+	{
+		for (size_t i = Capacity; i > 0; --i) {
+			free_.push_back(i - 1);
+		}
+	}
+	handle insert(int isbn) {
+		size_t slot = free_.back();
+		free_.pop_back();
+		slots_[slot] = { isbn, false, true };
+		return slot;
+	}
+	void touch(handle h) {
+		slots_[h].referenced = true;
+	}
+	void erase(handle h) {
+		slots_[h].used = false;
+		free_.push_back(h);
+	}
+	int evict() {
+		while (!slots_[hand_].used || slots_[hand_].referenced) {
+			slots_[hand_].referenced = false;
+			hand_ = (hand_ + 1) % Capacity;
+		}
+		int isbn = slots_[hand_].isbn;
+		erase(hand_);
+		hand_ = (hand_ + 1) % Capacity;
+		return isbn;
+	}
+	//the keys not referenced since the last sweep first, both in the order of the hand
+	template<typename Function>
+	void for_each(Function function) const {
+		for (bool referenced : { false, true }) {
+			for (size_t i = 0; i < Capacity; ++i) {
+				const Slot& slot = slots_[(hand_ + i) % Capacity];
+				if (slot.used && slot.referenced == referenced) {
+					function(slot.isbn);
+				}
+			}
+		}
+	}
+private:
+	struct Slot {
+		int isbn;
+		bool referenced;
+		bool used;
+	};
+	vector<Slot> slots_;
+	vector<size_t> free_;
+	size_t hand_ = 0;
+};
+
+/*
+S3-FIFO: a small FIFO queue (a tenth of the cache) filters keys which are used only once,
+keys hit while in it move on to the main FIFO queue, the others are evicted and remembered in a ghost queue.
+A key found in the ghost queue when it comes back goes straight to the main queue.
+The main queue reinserts keys which were hit since they were inserted (up to 3 times) instead of evicting them.
+A hit only increments a counter, nothing is reordered.
+*/
+template<size_t Capacity>
+class S3FIFOEviction {
+	struct Entry {
+		int isbn;
+		int frequency;
+		bool main;
+	};
+public:
+	typedef typename list<Entry>::iterator handle;
+
+	handle insert(int isbn) {
+		auto ghost = ghosts_.find(isbn);
+		if (ghost != ghosts_.end()) {
+			//the entry in ghost_ stays until it falls off the end, it doesn't match anymore by then
+			ghosts_.erase(ghost);
+			main_.push_front({ isbn, 0, true });
+			return main_.begin();
+		}
+		small_.push_front({ isbn, 0, false });
+		return small_.begin();
+	}
+	void touch(handle h) {
+		h->frequency = min(h->frequency + 1, 3);
+	}
+	void erase(handle h) {
+		(h->main ? main_ : small_).erase(h);
+	}
+	int evict() {
+		while (true) {
+			if (!small_.empty() && (small_.size() >= smallCapacity || main_.empty())) {
+				Entry& entry = small_.back();
+				if (entry.frequency > 0) {
+					entry.frequency = 0;
+					entry.main = true;
+					main_.splice(main_.begin(), small_, prev(small_.end()));
+					continue;
+				}
+				int isbn = entry.isbn;
+				small_.pop_back();
+				remember(isbn);
+				return isbn;
+			}
+			Entry& entry = main_.back();
+			if (entry.frequency > 0) {
+				--entry.frequency;
+				main_.splice(main_.begin(), main_, prev(main_.end()));
+				continue;
+			}
+			int isbn = entry.isbn;
+			main_.pop_back();
+			return isbn;
+		}
+	}
+	//the small queue first, oldest first in each queue
+	template<typename Function>
+	void for_each(Function function) const {
+		for (const list<Entry>* queue : { &small_, &main_ }) {
+			for (auto it = queue->rbegin(); it != queue->rend(); ++it) {
+				function(it->isbn);
+			}
+		}
+	}
+private:
+	static constexpr size_t smallCapacity = Capacity / 10 > 0 ? Capacity / 10 : 1;
+	//as many keys as the main queue holds
+	static constexpr size_t ghostCapacity = Capacity - smallCapacity > 0 ? Capacity - smallCapacity : 1;
+
+	list<Entry> small_;
+	list<Entry> main_;
+	//evicted keys with the number they were remembered as, oldest first
+	deque<pair<int, uint64_t>> ghost_;
+	//the number of the newest entry in ghost_ of every remembered key, the same key can be in ghost_ more than once
+	//and only its newest entry forgets it when it falls off the end
+	unordered_map<int, uint64_t> ghosts_;
+	uint64_t remembered_ = 0;
+
+	void remember(int isbn) {
+		ghost_.push_back({ isbn, remembered_ });
+		ghosts_[isbn] = remembered_++;
+		if (ghost_.size() > ghostCapacity) {
+			auto oldest = ghosts_.find(ghost_.front().first);
+			if (oldest != ghosts_.end() && oldest->second == ghost_.front().second) {
+				ghosts_.erase(oldest);
+			}
+			ghost_.pop_front();
+		}
+	}
+};
+
+/*
+Count-min sketch of how often keys were used recently, 4 bit counters in 4 rows of Width counters
+The estimate is the smallest of the key's counters in the rows, so it can only be too high, never too low.
+After 10 * Width increments every counter is halved so that old popularity fades.
+*/
+template<size_t Width>
+class FrequencySketch {
+public:
+	static_assert(Width > 0 && (Width & (Width - 1)) == 0, "Width has to be a power of two");
+
+	FrequencySketch() :counters_(rows * Width)
+	{}
+	void increment(int isbn) {
+		for (size_t row = 0; row < rows; ++row) {
+			uint8_t& counter = counters_[row * Width + column(isbn, row)];
+			if (counter < 15) {
+				++counter;
+			}
+		}
+		if (++additions_ == 10 * Width) {
+			for (uint8_t& counter : counters_) {
+				counter /= 2;
+			}
+			additions_ = 0;
+		}
+	}
+	unsigned estimate(int isbn) const {
+		unsigned frequency = 15;
+		for (size_t row = 0; row < rows; ++row) {
+			frequency = min<unsigned>(frequency, counters_[row * Width + column(isbn, row)]);
+		}
+		return frequency;
+	}
+private:
+	static constexpr size_t rows = 4;
+	vector<uint8_t> counters_;
+	size_t additions_ = 0;
+
+	//an independent multiplicative hash per row
+	static size_t column(int isbn, size_t row) {
+		static const uint64_t seeds[rows] = { 0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull, 0xD6E8FEB86659FD93ull };
+		uint64_t hash = (static_cast<uint64_t>(static_cast<unsigned int>(isbn)) + row) * seeds[row];
+		return static_cast<size_t>(hash >> 32) & (Width - 1);
+	}
+};
+
+/*
+W-TinyLFU: new keys enter a small LRU window (1% of the cache), keys leaving the window compete with
+the victim of the main cache for a place in it, the one the FrequencySketch estimates to be used more often wins.
+Keys used once, like a scan, lose against the established ones and never flush the main cache.
+The main cache is a segmented LRU: hits in its probation segment move keys to the protected segment (80% of it),
+keys pushed out of the protected segment go back to probation.
+*/
+template<size_t Capacity>
+class WTinyLFUEviction {
+	enum Segment { Window, Probation, Protected };
+	struct Entry {
+		int isbn;
+		Segment segment;
+	};
+public:
+	typedef typename list<Entry>::iterator handle;
+
+	handle insert(int isbn) {
+		sketch_.increment(isbn);
+		window_.push_front({ isbn, Window });
+		if (window_.size() > windowCapacity) {
+			//the cache isn't full yet, there is room in the main cache
+			Entry& entry = window_.back();
+			entry.segment = Probation;
+			probation_.splice(probation_.begin(), window_, prev(window_.end()));
+		}
+		return window_.begin();
+	}
+	void touch(handle h) {
+		sketch_.increment(h->isbn);
+		if (h->segment == Window) {
+			window_.splice(window_.begin(), window_, h);
+		}
+		else if (h->segment == Probation) {
+			h->segment = Protected;
+			protected_.splice(protected_.begin(), probation_, h);
+			if (protected_.size() > protectedCapacity) {
+				protected_.back().segment = Probation;
+				probation_.splice(probation_.begin(), protected_, prev(protected_.end()));
+			}
+		}
+		else {
+			protected_.splice(protected_.begin(), protected_, h);
+		}
+	}
+	void erase(handle h) {
+		segment(h->segment).erase(h);
+	}
+	//the window is full as well, its LRU key (the candidate) is about to be pushed out by the key being inserted
+	int evict() {
+		list<Entry>& main = probation_.empty() ? protected_ : probation_;
+		if (window_.empty() || (!main.empty() && window_.size() < windowCapacity)) {
+			return popBack(main);
+		}
+		if (main.empty()) {
+			return popBack(window_);
+		}
+		if (sketch_.estimate(window_.back().isbn) > sketch_.estimate(main.back().isbn)) {
+			int isbn = popBack(main);
+			window_.back().segment = Probation;
+			probation_.splice(probation_.begin(), window_, prev(window_.end()));
+			return isbn;
+		}
+		return popBack(window_);
+	}
+	//probation, window then protected, least recently used first in each segment
+	template<typename Function>
+	void for_each(Function function) const {
+		for (const list<Entry>* segment : { &probation_, &window_, &protected_ }) {
+			for (auto it = segment->rbegin(); it != segment->rend(); ++it) {
+				function(it->isbn);
+			}
+		}
+	}
+private:
+	static constexpr size_t windowCapacity = Capacity / 100 > 0 ? Capacity / 100 : 1;
+	static constexpr size_t protectedCapacity = (Capacity - min(Capacity, windowCapacity)) * 4 / 5;
+
+	static constexpr size_t sketchWidth() {
+		size_t width = 16;
+		while (width < Capacity) {
+			width *= 2;
+		}
+		return width;
+	}
+
+	list<Entry> window_;
+	list<Entry> probation_;
+	list<Entry> protected_;
+	FrequencySketch<sketchWidth()> sketch_;
+
+	list<Entry>& segment(Segment segment) {
+		return segment == Window ? window_ : segment == Probation ? probation_ : protected_;
+	}
+	static int popBack(list<Entry>& queue) {
+		int isbn = queue.back().isbn;
+		queue.pop_back();
+		return isbn;
+	}
+};
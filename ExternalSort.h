@@ -0,0 +1,279 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "LoserTree.h"
+
+using namespace std;
+
+/*
+Run files are the raw elements (native byte order, no header) of a sorted run of a trivially copyable type.
+Merging and sorting them only keeps fixed size blocks of the files in memory, never the runs themselves.
+*/
+
+/*
+Reads a run file in blocks of a fixed number of elements with read ahead:
+there are two buffers, while one block is being merged the next one is read into the other buffer by the reader's thread.
+The thread lives as long as the reader and waits between blocks, a block costs a wake up instead of a thread start
+*/
+template<typename T>
+class RunFileReader {
+public:
+	static_assert(is_trivially_copyable<T>::value, "Run files hold trivially copyable elements");
+
+	//Throws if the file can't be opened
+	RunFileReader(const string& path, size_t blockSize) :file_(path, ios::binary), blockSize_{ blockSize }
+	{
+		if (!file_) {
+			throw("Cannot open the file");
+		}
+		buffers_[0].resize(blockSize);
+		buffers_[1].resize(blockSize);
+		thread_ = thread([this] { readAhead(); });
+	}
+	//the read ahead thread uses the buffers and the file
+	RunFileReader(const RunFileReader& other) = delete;
+	RunFileReader& operator=(const RunFileReader& other) = delete;
+	//waits for the read in progress
+	~RunFileReader() {
+		{
+			lock_guard<mutex> lock(mutex_);
+			stopping_ = true;
+		}
+		changed_.notify_all();
+		thread_.join();
+	}
+
+	/*
+	Next block of the file, empty once the whole file was read
+	The block stays valid until the next call. Throws if the file can't be read or is cut in the middle of an element
+	*/
+	pair<const T*, const T*> next() {
+		if (!pending_) {
+			return { nullptr, nullptr };
+		}
+		unique_lock<mutex> lock(mutex_);
+		changed_.wait(lock, [this] { return !requested_; });
+		pending_ = false;
+		if (error_ != nullptr) {
+			throw(error_);
+		}
+		current_ ^= 1;
+		const T* block = buffers_[current_].data();
+		size_t count = count_;
+		//a short block is the end of the file
+		if (count == blockSize_) {
+			pending_ = true;
+			requested_ = true;
+			lock.unlock();
+			changed_.notify_all();
+		}
+		return { block, block + count };
+	}
+private:
+	ifstream file_;
+	size_t blockSize_;
+	vector<T> buffers_[2];
+	//buffer of the block returned last, the other one is being read into
+	size_t current_ = 1;
+	//whether a block was requested and not returned by next() yet, only used by the caller of next()
+	bool pending_ = true;
+	//guards the fields below, changed_ is notified when one of them changes
+	mutex mutex_;
+	condition_variable changed_;
+	//set by next() for the thread to read a block, cleared by the thread once count_ or error_ is set
+	bool requested_ = true;
+	bool stopping_ = false;
+	size_t count_ = 0;
+	const char* error_ = nullptr;
+	//last, started once everything it uses is constructed
+	thread thread_;
+
+	//body of the thread: reads a block into the other buffer whenever one is requested
+	void readAhead() {
+		unique_lock<mutex> lock(mutex_);
+		while (true) {
+			changed_.wait(lock, [this] { return requested_ || stopping_; });
+			if (stopping_) {
+				return;
+			}
+			T* into = buffers_[current_ ^ 1].data();
+			lock.unlock();
+			file_.read(reinterpret_cast<char*>(into), blockSize_ * sizeof(T));
+			size_t bytes = static_cast<size_t>(file_.gcount());
+			const char* error = nullptr;
+			if (file_.bad()) {
+				error = "Cannot read the file";
+			}
+			else if (bytes % sizeof(T) != 0) {
+				error = "Run file size is not a whole number of elements";
+			}
+			lock.lock();
+			count_ = bytes / sizeof(T);
+			error_ = error;
+			requested_ = false;
+			changed_.notify_all();
+		}
+	}
+};
+
+//Sink of MergeRunFiles writing the chunks to a run file
+template<typename T>
+class RunFileWriter {
+public:
+	static_assert(is_trivially_copyable<T>::value, "Run files hold trivially copyable elements");
+
+	//Replaces the file at path. Throws if it can't be opened
+	explicit RunFileWriter(const string& path) :file_(path, ios::binary | ios::trunc)
+	{
+		if (!file_) {
+			throw("Cannot open the file for writing");
+		}
+	}
+	void operator()(const T* chunk, size_t count) {
+		file_.write(reinterpret_cast<const char*>(chunk), count * sizeof(T));
+		if (!file_) {
+			throw("Cannot write the file");
+		}
+	}
+	//Flushes and closes the file, throws if it couldn't be written completely
+	void close() {
+		file_.close();
+		if (!file_) {
+			throw("Cannot write the file");
+		}
+	}
+private:
+	ofstream file_;
+};
+
+/*
+Merges the sorted run files into sink(const T* chunk, size_t count), called with consecutive chunks of the output
+memoryBudget (in bytes) is shared by two buffers per run and the output chunk, the runs are streamed through
+a LoserTree block by block. Throws if the budget doesn't hold a single element per buffer or a file can't be read
+*/
+template<typename T, typename Sink, typename Compare = less<T>>
+void MergeRunFiles(const vector<string>& paths, Sink&& sink, size_t memoryBudget, Compare compare = Compare()) {
+	size_t blockSize = memoryBudget / sizeof(T) / (2 * paths.size() + 1);
+	if (blockSize == 0) {
+		throw("Memory budget too small for this many runs");
+	}
+	vector<unique_ptr<RunFileReader<T>>> readers;
+	vector<pair<const T*, const T*>> blocks;
+	readers.reserve(paths.size());
+	blocks.reserve(paths.size());
+	for (const string& path : paths) {
+		readers.emplace_back(new RunFileReader<T>(path, blockSize));
+	}
+	for (unique_ptr<RunFileReader<T>>& reader : readers) {
+		blocks.push_back(reader->next());
+	}
+	LoserTree<T, Compare> tree(blocks, compare);
+	vector<T> chunk(blockSize);
+	size_t filled = 0;
+	while (!tree.empty()) {
+		size_t run = tree.topRun();
+		const T* head = &tree.top();
+		chunk[filled] = *head;
+		if (++filled == blockSize) {
+			sink(chunk.data(), filled);
+			filled = 0;
+		}
+		//the next block overwrites the buffer before the current one, the head is copied already
+		if (head + 1 == blocks[run].second) {
+			blocks[run] = readers[run]->next();
+			tree.pop(blocks[run].first, blocks[run].second);
+		}
+		else {
+			tree.pop();
+		}
+	}
+	if (filled > 0) {
+		sink(chunk.data(), filled);
+	}
+}
+
+/*
+Sorts the elements of the file at input into the file at output, keeping at most memoryBudget bytes of elements in memory
+Run generation sorts memoryBudget sized pieces of the input into run files next to the output (output.run0, output.run1...).
+While there are more runs than fanIn, groups of fanIn runs are merged into longer runs, the last pass merges into output.
+Every pass reads and writes the whole data once: run generation and then ceil(log(runs) / log(fanIn)) merge passes.
+Not stable. The run files are removed once merged, they are left behind if an exception stops the sort
+*/
+template<typename T, typename Compare = less<T>>
+void ExternalSort(const string& input, const string& output, size_t memoryBudget, size_t fanIn = 64, Compare compare = Compare()) {
+	if (fanIn < 2) {
+		throw("The fan-in has to be at least 2");
+	}
+	vector<string> runs;
+	size_t runNumber = 0;
+	{
+		ifstream file(input, ios::binary);
+		if (!file) {
+			throw("Cannot open the file");
+		}
+		vector<T> piece(max<size_t>(1, memoryBudget / sizeof(T)));
+		while (true) {
+			file.read(reinterpret_cast<char*>(piece.data()), piece.size() * sizeof(T));
+			if (file.bad()) {
+				throw("Cannot read the file");
+			}
+			size_t bytes = static_cast<size_t>(file.gcount());
+			if (bytes % sizeof(T) != 0) {
+				throw("Input file size is not a whole number of elements");
+			}
+			if (bytes == 0) {
+				break;
+			}
+			size_t count = bytes / sizeof(T);
+			sort(piece.begin(), piece.begin() + count, compare);
+			runs.push_back(output + ".run" + to_string(runNumber++));
+			RunFileWriter<T> writer(runs.back());
+			writer(piece.data(), count);
+			writer.close();
+			if (count < piece.size()) {
+				break;
+			}
+		}
+	}
+	while (runs.size() > fanIn) {
+		vector<string> merged;
+		for (size_t first = 0; first < runs.size(); first += fanIn) {
+			vector<string> group(runs.begin() + first, runs.begin() + min(runs.size(), first + fanIn));
+			if (group.size() == 1) {
+				merged.push_back(group[0]);
+				continue;
+			}
+			merged.push_back(output + ".run" + to_string(runNumber++));
+			RunFileWriter<T> writer(merged.back());
+			MergeRunFiles<T>(group, writer, memoryBudget, compare);
+			writer.close();
+			for (const string& run : group) {
+				remove(run.c_str());
+			}
+		}
+		runs.swap(merged);
+	}
+	if (runs.size() == 1) {
+		//a single run is sorted already
+		remove(output.c_str());
+		if (rename(runs[0].c_str(), output.c_str()) == 0) {
+			return;
+		}
+	}
+	RunFileWriter<T> writer(output);
+	MergeRunFiles<T>(runs, writer, memoryBudget, compare);
+	writer.close();
+	for (const string& run : runs) {
+		remove(run.c_str());
+	}
+}
@@ -0,0 +1,241 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <xmmintrin.h>
+#endif
+
+namespace CustomBinaryTree {
+	template<typename KeyType, typename ValueType>
+	class MappedTree;
+
+	/*
+	Immutable, read optimized copy of a BinaryTree (see BinaryTree::freeze)
+	Keys are kept in a contiguous array in Eytzinger (BFS) order: the children of index i are at 2i and 2i+1,
+	the root is at 1 and index 0 is unused. The top levels of the tree share a handful of cache lines and
+	since the descendants of i at depth d below it are adjacent (from i*2^d on) they can be prefetched
+	several levels ahead of the comparisons.
+	The search itself has no data dependent branches, the result of each comparison becomes part of the next index.
+	Entries (key-value pairs) are stored in the same order in a separate array so the keys stay dense.
+	The arrays are either owned by the FrozenTree or, for a MappedTree, live in a memory mapped file.
+	*/
+	template<typename KeyType, typename ValueType>
+	class FrozenTree {
+	public:
+		using value_type = std::pair<KeyType, ValueType>;
+		class const_iterator;
+
+		FrozenTree() :keyStorage_(1), entryStorage_(1)
+		{
+			point();
+		}
+		/*
+		Builds from a range which is already in order, like the in order traversal of a BinaryTree
+		Runs in O(n)
+		*/
+		template<typename InputIterator>
+		FrozenTree(InputIterator first, InputIterator last) {
+			std::vector<value_type> sorted;
+			for (; first != last; ++first) {
+				sorted.push_back(*first);
+			}
+			keyStorage_.resize(sorted.size() + 1);
+			entryStorage_.resize(sorted.size() + 1);
+			point();
+			size_t next = 0;
+			fill(sorted, next, 1);
+		}
+		//a copy of a FrozenTree owning its arrays owns a copy of them, a copy of a view is a view of the same arrays
+		FrozenTree(const FrozenTree& other) :keyStorage_{ other.keyStorage_ }, entryStorage_{ other.entryStorage_ },
+			keys_{ other.keys_ }, entries_{ other.entries_ }, size_{ other.size_ }
+		{
+			if (!keyStorage_.empty()) {
+				point();
+			}
+		}
+		//moving a vector keeps its buffer so the pointers stay valid
+		FrozenTree(FrozenTree&& other) = default;
+		FrozenTree& operator=(FrozenTree other) {
+			keyStorage_.swap(other.keyStorage_);
+			entryStorage_.swap(other.entryStorage_);
+			std::swap(keys_, other.keys_);
+			std::swap(entries_, other.entries_);
+			std::swap(size_, other.size_);
+			return *this;
+		}
+
+		size_t size() const {
+			return size_;
+		}
+		bool empty() const {
+			return size() == 0;
+		}
+
+		/*
+		Searches the given key
+		Returns: An iterator to the element, if an element with specified key is found, or end otherwise.
+		*/
+		const_iterator find(const KeyType& key) const {
+			size_t index = lowerBound(key);
+			if (index != 0 && !(key < keys_[index])) {
+				return const_iterator(this, index);
+			}
+			return end();
+		}
+		//Returns: An iterator to the first element whose key is not less than the given key, or end if there is none
+		const_iterator lower_bound(const KeyType& key) const {
+			return const_iterator(this, lowerBound(key));
+		}
+
+		//iteration using begin and end does an inorder traversal, same as the BinaryTree it was frozen from
+		const_iterator begin() const {
+			size_t index = 1;
+			if (empty()) {
+				return end();
+			}
+			while (2 * index <= size()) {
+				index = 2 * index;
+			}
+			return const_iterator(this, index);
+		}
+		const_iterator end() const {
+			return const_iterator(this, 0);
+		}
+		const_iterator cbegin() const {
+			return begin();
+		}
+		const_iterator cend() const {
+			return end();
+		}
+
+		class const_iterator {
+		public:
+			//Equaltiy check operators
+			bool operator == (const const_iterator& rhs) const {
+				return index_ == rhs.index_;
+			}
+			bool operator != (const const_iterator& rhs) const {
+				return !(*this == rhs);
+			}
+
+			//de-reference operator
+			const std::pair<KeyType, ValueType>& operator* () const {
+				return tree_->entries_[index_];
+			}
+			const std::pair<KeyType, ValueType>* operator-> () const {
+				return &tree_->entries_[index_];
+			}
+			//pre-increment operator
+			const_iterator& operator ++() {
+				index_ = tree_->next(index_);
+				return *this;
+			}
+			//post-increment operator
+			const_iterator operator ++(int) {
+				const_iterator temp = *this;
+				index_ = tree_->next(index_);
+				return temp;
+			}
+
+			//Necessary traits
+			typedef std::forward_iterator_tag iterator_category;
+			typedef ValueType value_type;
+			typedef int difference_type;
+		private:
+			friend class FrozenTree;
+			const_iterator(const FrozenTree* tree, size_t index) :tree_{ tree }, index_{ index }
+			{}
+			const FrozenTree* tree_;
+			//Eytzinger index, 0 is end
+			size_t index_;
+		};
+	private:
+		friend class MappedTree<KeyType, ValueType>;
+
+		//empty for a view
+		std::vector<KeyType> keyStorage_;
+		std::vector<value_type> entryStorage_;
+		//size_ + 1 elements each, the first one is unused
+		const KeyType* keys_;
+		const value_type* entries_;
+		size_t size_;
+
+		//view of arrays owned by someone else
+		FrozenTree(const KeyType* keys, const value_type* entries, size_t size) :keys_{ keys }, entries_{ entries }, size_{ size }
+		{}
+		void point() {
+			keys_ = keyStorage_.data();
+			entries_ = entryStorage_.data();
+			size_ = keyStorage_.size() - 1;
+		}
+
+		//in order traversal of the implicit tree, hands out the sorted elements one after another
+		void fill(const std::vector<value_type>& sorted, size_t& next, size_t index) {
+			if (index > size()) {
+				return;
+			}
+			fill(sorted, next, 2 * index);
+			keyStorage_[index] = sorted[next].first;
+			entryStorage_[index] = sorted[next];
+			++next;
+			fill(sorted, next, 2 * index + 1);
+		}
+
+		/*
+		Every step goes left (2i) if key <= keys_[i] and right (2i+1) otherwise, the bits of the final index
+		are the path taken. The lower bound is the last node where the path went left,
+		so dropping the trailing right turns (1 bits) and that one left turn gives its index, 0 if there was none.
+		*/
+		size_t lowerBound(const KeyType& key) const {
+			const size_t n = size();
+			size_t index = 1;
+			while (index <= n) {
+				prefetch(index * prefetchStride);
+				index = 2 * index + (keys_[index] < key);
+			}
+			return index >> (trailingOnes(index) + 1);
+		}
+
+		//in order successor, 0 after the last element
+		size_t next(size_t index) const {
+			if (2 * index + 1 <= size()) {
+				index = 2 * index + 1;
+				while (2 * index <= size()) {
+					index = 2 * index;
+				}
+				return index;
+			}
+			return index >> (trailingOnes(index) + 1);
+		}
+
+		//prefetch the descendants of the node which are this many times its index,
+		//they are log2(prefetchStride) levels down and together fill one cache line
+		static constexpr size_t prefetchStride = sizeof(KeyType) >= 64 ? 1 : 64 / sizeof(KeyType);
+
+		//the index may be past the end of the array: the address is computed as an integer since such a pointer
+		//would be undefined even without dereferencing it, the prefetch itself never faults
+		void prefetch(size_t index) const {
+			const char* address = reinterpret_cast<const char*>(reinterpret_cast<uintptr_t>(keys_) + index * sizeof(KeyType));
+#if defined(_MSC_VER)
+			_mm_prefetch(address, _MM_HINT_T0);
+#else
+			__builtin_prefetch(address);
+#endif
+		}
+
+		static unsigned trailingOnes(size_t index) {
+			unsigned long long inverted = ~static_cast<unsigned long long>(index);
+#if defined(_MSC_VER)
+			unsigned long position;
+			_BitScanForward64(&position, inverted);
+			return position;
+#else
+			return __builtin_ctzll(inverted);
+#endif
+		}
+	};
+}
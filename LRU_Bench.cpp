@@ -0,0 +1,227 @@
+#include "stdafx.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+#include "LRU_Cache.h"
+
+using namespace std;
+
+/*
+Benchmarks of the caches, build with optimizations
+	LRU_Bench sharded : lookup else insert from 1 to 64 threads, ShardedLRUCache against one LRUCache behind a mutex
+	LRU_Bench flat    : hits and evicting inserts with the allocations per operation, FlatLRUCache against LRUCache
+	LRU_Bench batch   : FlatLRUCache::lookup_batch for batches of 1 to 256 isbns against plain lookups, on a cache larger than the caches of the processor
+	LRU_Bench snapshot: save and load of 10M entries against inserting them, writes LRU_Bench.snapshot into the current directory
+*/
+typedef chrono::steady_clock BenchClock;
+
+//every allocation of the program is counted, the array forms are replaced too so that new and delete always pair malloc with free
+static atomic<size_t> allocations{ 0 };
+
+static void* countedAllocation(size_t size) {
+	++allocations;
+	void* memory = malloc(size == 0 ? 1 : size);
+	if (memory == nullptr) {
+		throw bad_alloc();
+	}
+	return memory;
+}
+void* operator new(size_t size) {
+	return countedAllocation(size);
+}
+void* operator new[](size_t size) {
+	return countedAllocation(size);
+}
+void operator delete(void* memory) noexcept {
+	free(memory);
+}
+void operator delete[](void* memory) noexcept {
+	free(memory);
+}
+void operator delete(void* memory, size_t) noexcept {
+	free(memory);
+}
+void operator delete[](void* memory, size_t) noexcept {
+	free(memory);
+}
+
+double secondsSince(BenchClock::time_point start) {
+	return chrono::duration<double>(BenchClock::now() - start).count();
+}
+
+//ops lookups spread over threads, each one a lookup of a random isbn of keys and an insert when it missed
+template<typename Access>
+double lookupElseInsert(size_t threads, size_t ops, int keys, Access access) {
+	vector<thread> workers;
+	BenchClock::time_point start = BenchClock::now();
+	for (size_t t = 0; t < threads; ++t) {
+		workers.emplace_back([t, threads, ops, keys, &access] {
+			mt19937 random(static_cast<unsigned>(t));
+			for (size_t i = 0; i < ops / threads; ++i) {
+				access(static_cast<int>(random() % keys));
+			}
+		});
+	}
+	for (thread& worker : workers) {
+		worker.join();
+	}
+	return ops / threads * threads / secondsSince(start) / 1e6;
+}
+
+void benchSharded() {
+	const size_t capacity = 100000;
+	const size_t ops = 400000;
+	const int keys = 120000;
+	unique_ptr<ShardedLRUCache<capacity, 64>> sharded(new ShardedLRUCache<capacity, 64>());
+	unique_ptr<LRUCache<capacity>> single(new LRUCache<capacity>());
+	mutex singleMutex;
+	for (int i = 0; i < static_cast<int>(capacity); ++i) {
+		sharded->insert(i, i);
+		single->insert(i, i);
+	}
+	printf("%zu entries, %d keys\n", capacity, keys);
+	for (size_t threads = 1; threads <= 64; threads *= 2) {
+		double shardedRate = lookupElseInsert(threads, ops, keys, [&sharded](int isbn) {
+			int price;
+			if (!sharded->lookup(isbn, &price)) {
+				sharded->insert(isbn, isbn);
+			}
+		});
+		double singleRate = lookupElseInsert(threads, ops, keys, [&single, &singleMutex](int isbn) {
+			lock_guard<mutex> lock(singleMutex);
+			int price;
+			if (!single->lookup(isbn, &price)) {
+				single->insert(isbn, isbn);
+			}
+		});
+		printf("%2zu threads: ShardedLRUCache<64 shards> %5.2f Mops/s  LRUCache + mutex %5.2f Mops/s\n", threads, shardedRate, singleRate);
+	}
+}
+
+template<typename Cache>
+void hitsAndEvictions(const char* name) {
+	const int capacity = 100000;
+	const size_t lookups = 4000000;
+	const int inserts = 1000000;
+	unique_ptr<Cache> cache(new Cache());
+	for (int i = 0; i < capacity; ++i) {
+		cache->insert(i * 7, i);
+	}
+	mt19937 random(1);
+	vector<int> isbns(lookups);
+	for (int& isbn : isbns) {
+		isbn = static_cast<int>(random() % capacity) * 7;
+	}
+	long long sum = 0;
+	size_t before = allocations;
+	BenchClock::time_point start = BenchClock::now();
+	for (int isbn : isbns) {
+		int price = 0;
+		cache->lookup(isbn, &price);
+		sum += price;
+	}
+	double seconds = secondsSince(start);
+	printf("%s hits            %5.1f Mops/s  %.2f allocations/op\n", name, lookups / seconds / 1e6, double(allocations - before) / lookups);
+	before = allocations;
+	start = BenchClock::now();
+	for (int i = 0; i < inserts; ++i) {
+		cache->insert(1000000 + i, i);
+	}
+	seconds = secondsSince(start);
+	printf("%s evicting inserts %5.1f Mops/s  %.2f allocations/op  (%lld)\n", name, inserts / seconds / 1e6, double(allocations - before) / inserts, sum);
+}
+
+void benchFlat() {
+	hitsAndEvictions<LRUCache<100000>>("LRUCache    ");
+	hitsAndEvictions<FlatLRUCache<100000>>("FlatLRUCache");
+}
+
+void benchBatch() {
+	const size_t capacity = size_t(1) << 21;
+	const size_t lookups = 4000000;
+	unique_ptr<FlatLRUCache<capacity>> cache(new FlatLRUCache<capacity>());
+	for (size_t i = 0; i < capacity; ++i) {
+		cache->insert(static_cast<int>(i * 2654435761u), static_cast<int>(i));
+	}
+	mt19937 random(1);
+	vector<int> isbns(lookups);
+	for (int& isbn : isbns) {
+		isbn = static_cast<int>((random() % capacity) * 2654435761u);
+	}
+	vector<int> prices(lookups);
+	unique_ptr<bool[]> found(new bool[lookups]);
+	printf("%zu entries, %zu random lookups\n", capacity, lookups);
+	BenchClock::time_point start = BenchClock::now();
+	size_t hits = 0;
+	for (size_t i = 0; i < lookups; ++i) {
+		found[i] = cache->lookup(isbns[i], &prices[i]);
+		hits += found[i];
+	}
+	printf("lookup loop   %5.1f Mops/s  (%zu hits)\n", lookups / secondsSince(start) / 1e6, hits);
+	for (size_t batch = 1; batch <= 256; batch *= 2) {
+		start = BenchClock::now();
+		hits = 0;
+		for (size_t i = 0; i + batch <= lookups; i += batch) {
+			hits += cache->lookup_batch(&isbns[i], batch, &prices[i], &found[i]);
+		}
+		printf("batches of %3zu %5.1f Mops/s  (%zu hits)\n", batch, lookups / secondsSince(start) / 1e6, hits);
+	}
+}
+
+void benchSnapshot() {
+	const size_t capacity = 10000000;
+	const char* path = "LRU_Bench.snapshot";
+	{
+		unique_ptr<LRUCache<capacity>> cache(new LRUCache<capacity>());
+		for (size_t i = 0; i < capacity; ++i) {
+			cache->insert(static_cast<int>(i * 2654435761u), static_cast<int>(i));
+		}
+		BenchClock::time_point start = BenchClock::now();
+		cache->save(path);
+		printf("save %zu entries          %8.0f ms\n", capacity, secondsSince(start) * 1e3);
+	}
+	{
+		unique_ptr<LRUCache<capacity>> cache(new LRUCache<capacity>());
+		BenchClock::time_point start = BenchClock::now();
+		cache->load(path);
+		printf("load %zu entries          %8.0f ms\n", capacity, secondsSince(start) * 1e3);
+	}
+	{
+		unique_ptr<LRUCache<capacity>> cache(new LRUCache<capacity>());
+		BenchClock::time_point start = BenchClock::now();
+		for (size_t i = 0; i < capacity; ++i) {
+			cache->insert(static_cast<int>(i * 2654435761u), static_cast<int>(i));
+		}
+		printf("insert %zu entries        %8.0f ms\n", capacity, secondsSince(start) * 1e3);
+	}
+	remove(path);
+}
+
+int main(int argc, char* argv[]) {
+	const char* benchmark = argc > 1 ? argv[1] : "";
+	if (strcmp(benchmark, "sharded") == 0) {
+		benchSharded();
+	}
+	else if (strcmp(benchmark, "flat") == 0) {
+		benchFlat();
+	}
+	else if (strcmp(benchmark, "batch") == 0) {
+		benchBatch();
+	}
+	else if (strcmp(benchmark, "snapshot") == 0) {
+		benchSnapshot();
+	}
+	else {
+		fprintf(stderr, "usage: %s sharded|flat|batch|snapshot\n", argv[0]);
+		return 1;
+	}
+	return 0;
+}
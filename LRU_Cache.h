@@ -0,0 +1,667 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#if defined(_MSC_VER)
+#include <xmmintrin.h>
+#endif
+#include "CacheSnapshot.h"
+#include "CacheStats.h"
+#include "EvictionPolicies.h"
+#include "TimerWheel.h"
+#include "WorkStealingPool.h"
+
+using namespace std;
+
+/*
+Cache of prices by isbn holding at most Capacity entries
+EvictionPolicy (see EvictionPolicies.h) picks the entry to evict when a new isbn is inserted into a full cache,
+least recently used by default.
+Entries can be given a time to live in the ticks of Clock (milliseconds for SteadyClock), lookup never returns
+an expired entry and expired entries are removed by a TimerWheel as time goes by, so they don't take up capacity
+until the eviction policy gets to them. Caches without such entries never read the clock.
+stats() counts hits, misses, inserts, evictions and expirations (see CacheStats.h).
+save and load write the entries to a file and read them back in recency order (see CacheSnapshot.h),
+to warm up a new process with the contents of the previous one.
+*/
+template<size_t Capacity, template<size_t> class EvictionPolicy = LRUEviction, typename Clock = SteadyClock>
+class LRUCache {
+public:
+	static constexpr uint64_t noExpiry = 0;
+
+	explicit LRUCache(Clock clock = Clock()) :clock_{ clock }
+	{}
+
+	bool lookup(int isbn, int *price) {
+		return lookup(isbn, price, nullptr);
+	}
+	//same as lookup, also sets expiry to the tick the entry expires at (noExpiry if it doesn't) when it is found
+	bool lookup(int isbn, int *price, uint64_t *expiry) {
+#if defined(LRU_CACHE_LATENCY)
+		LatencyTimer timer(stats_.lookupLatency);
+#endif
+		auto iter = find(isbn);
+		if (iter == cache_map_.end()) {
+			++stats_.misses;
+			return false;
+		}
+		++stats_.hits;
+		*price = iter->second.price;
+		policy_.touch(iter->second.handle);
+		if (expiry != nullptr) {
+			*expiry = iter->second.timer == TimerWheel::handle() ? noExpiry : TimerWheel::expiry(iter->second.timer);
+		}
+
+		return true;
+	}
+	/*
+	Inserts the isbn with the price, it expires ttl ticks from now unless ttl is noExpiry
+	If the isbn is in the cache already it only counts as used, its price and expiry stay the same
+	*/
+	void insert(int isbn, int p, uint64_t ttl = noExpiry) {
+		auto iter = find(isbn);
+		if (iter == cache_map_.end()) {
+			if (cache_map_.size() == Capacity) {
+				//If the max capacity of the cache has reached we need to remove
+				//the entry the policy picks from the table
+				remove(cache_map_.find(policy_.evict()));
+				++stats_.evictions;
+			}
+			typename Policy::handle handle = policy_.insert(isbn);
+			try {
+				CacheVal& val = cache_map_[isbn];
+				val = { p, handle, TimerWheel::handle() };
+				if (ttl != noExpiry) {
+					val.timer = timers_.schedule(isbn, clock_.now() + ttl);
+				}
+			}
+			catch (...) {
+				//nothing of the isbn is left behind for a later lookup to find half made
+				cache_map_.erase(isbn);
+				policy_.erase(handle);
+				throw;
+			}
+			++stats_.inserts;
+		}
+		else {
+			//found the isbn in table
+			policy_.touch(iter->second.handle);
+		}
+	}
+	bool erase(int isbn) {
+		auto it = find(isbn);
+		if (it == cache_map_.end()) {
+			return false;
+		}
+		else {
+			policy_.erase(it->second.handle);
+			remove(it);
+			return true;
+		}
+	}
+
+	Clock& clock() {
+		return clock_;
+	}
+	const CacheStats& stats() const {
+		return stats_;
+	}
+	void resetStats() {
+		stats_ = CacheStats();
+	}
+
+	//Appends the entries which didn't expire to out, in the order the policy would evict them (least recently used first)
+	void copyEntries(vector<CacheEntry>& out) const {
+		uint64_t now = timers_.empty() ? 0 : clock_.now();
+		policy_.for_each([this, now, &out](int isbn) {
+			const CacheVal& val = cache_map_.find(isbn)->second;
+			if (val.timer == TimerWheel::handle()) {
+				out.push_back({ isbn, val.price, noExpiry });
+			}
+			else if (TimerWheel::expiry(val.timer) > now) {
+				out.push_back({ isbn, val.price, TimerWheel::expiry(val.timer) - now });
+			}
+		});
+	}
+	//Writes the entries to the file at path. Throws if the file can't be written
+	void save(const string& path) const {
+		vector<CacheEntry> entries;
+		entries.reserve(cache_map_.size());
+		copyEntries(entries);
+		CacheSnapshot::write(entries, path);
+	}
+	/*
+	Inserts the entries saved in the file at path in the order they were saved, so the most recently used ones
+	are the most recently used ones again, and they expire as much later as they had left
+	If there are more than Capacity the least recently used ones are evicted, as inserting them one by one would.
+	Throws if the file can't be read
+	*/
+	void load(const string& path) {
+		vector<CacheEntry> entries = CacheSnapshot::read(path);
+		cache_map_.reserve(min(Capacity, cache_map_.size() + entries.size()));
+		for (const CacheEntry& entry : entries) {
+			insert(entry.isbn, entry.price, entry.ttl);
+		}
+	}
+private:
+	typedef EvictionPolicy<Capacity> Policy;
+	struct CacheVal {
+		int price;
+		typename Policy::handle handle;
+		//value initialized for entries which never expire
+		TimerWheel::handle timer;
+	};
+	typedef unordered_map<int, CacheVal> Table;
+	Table cache_map_;
+	Policy policy_;
+	TimerWheel timers_;
+	Clock clock_;
+	CacheStats stats_;
+
+	//finds the isbn after removing the entries which expired by now
+	typename Table::iterator find(int isbn) {
+		if (timers_.empty()) {
+			return cache_map_.find(isbn);
+		}
+		uint64_t now = clock_.now();
+		timers_.advance(now, [this](int expired) {
+			auto iter = cache_map_.find(expired);
+			policy_.erase(iter->second.handle);
+			cache_map_.erase(iter);
+			++stats_.expirations;
+		});
+		auto iter = cache_map_.find(isbn);
+		//the wheel is done with the past ticks only, the current one is checked here
+		if (iter != cache_map_.end() && iter->second.timer != TimerWheel::handle() && TimerWheel::expiry(iter->second.timer) <= now) {
+			policy_.erase(iter->second.handle);
+			remove(iter);
+			++stats_.expirations;
+			return cache_map_.end();
+		}
+		return iter;
+	}
+	//removes the entry from the table and the wheel, the policy isn't tracking it anymore
+	void remove(typename Table::iterator iter) {
+		if (iter->second.timer != TimerWheel::handle()) {
+			timers_.cancel(iter->second.timer);
+		}
+		cache_map_.erase(iter);
+	}
+};
+
+/*
+LRUCache which allocates nothing after construction
+Entries live in a preallocated array and the recency list is threaded through them as indices,
+the isbn to entry index table uses open addressing (linear probing) with at least twice Capacity slots.
+A hit touches the table slot and the entry plus the entries of its list neighbours, no node is freed or allocated.
+lookup, insert and erase behave the same as for LRUCache.
+lookup_batch and insert_batch hash a whole group of isbns first and prefetch what they will touch,
+so the cache misses of the group overlap instead of being waited for one after another.
+*/
+template<size_t Capacity>
+class FlatLRUCache {
+public:
+	static_assert(Capacity > 0 && Capacity < 0x7FFFFFFF, "Capacity has to fit the 32 bit entry indices");
+
+	FlatLRUCache() :entries_(Capacity + 1), slots_(tableSize(), Slot{ 0, none })
+	{
+		//the entry at Capacity is the head of the circular recency list, the rest start out on the free list
+		entries_[head].prev = entries_[head].next = head;
+		for (uint32_t i = 0; i < Capacity; ++i) {
+			entries_[i].next = i + 1 < Capacity ? i + 1 : none;
+		}
+		free_ = 0;
+	}
+
+	bool lookup(int isbn, int *price) {
+#if defined(LRU_CACHE_LATENCY)
+		LatencyTimer timer(stats_.lookupLatency);
+#endif
+		size_t slot = find(isbn);
+		if (slots_[slot].entry == none) {
+			++stats_.misses;
+			return false;
+		}
+		++stats_.hits;
+		uint32_t entry = slots_[slot].entry;
+		*price = entries_[entry].price;
+		moveToFront(entry);
+		return true;
+	}
+	void insert(int isbn, int p) {
+		size_t slot = find(isbn);
+		if (slots_[slot].entry != none) {
+			//found the isbn in table
+			moveToFront(slots_[slot].entry);
+			return;
+		}
+		if (size_ == Capacity) {
+			//If the max capacity of the cache has reached we need to remove
+			//Least Recently Used entry from the table
+			erase(entries_[entries_[head].prev].isbn);
+			slot = find(isbn);
+			++stats_.evictions;
+		}
+		++stats_.inserts;
+		uint32_t entry = free_;
+		free_ = entries_[entry].next;
+		entries_[entry].isbn = isbn;
+		entries_[entry].price = p;
+		link(entry);
+		slots_[slot].isbn = isbn;
+		slots_[slot].entry = entry;
+		++size_;
+	}
+	bool erase(int isbn) {
+		size_t slot = find(isbn);
+		if (slots_[slot].entry == none) {
+			return false;
+		}
+		uint32_t entry = slots_[slot].entry;
+		unlink(entry);
+		entries_[entry].next = free_;
+		free_ = entry;
+		removeSlot(slot);
+		--size_;
+		return true;
+	}
+	/*
+	Looks up count isbns, same as calling lookup for each one in order
+	prices[i] is set and found[i] is true if isbns[i] was found, found[i] is false otherwise
+	Returns: The number of isbns found
+	*/
+	size_t lookup_batch(const int* isbns, size_t count, int* prices, bool* found) {
+		size_t hits = 0;
+		size_t slots[batchGroup];
+		for (size_t first = 0; first < count; first += batchGroup) {
+			size_t group = min(batchGroup, count - first);
+			if (group < minBatchGroup) {
+				//too few to win over the overlap the processor finds among plain lookups
+				for (size_t i = first; i < count; ++i) {
+					found[i] = lookup(isbns[i], &prices[i]);
+					hits += found[i];
+				}
+				break;
+			}
+			for (size_t i = 0; i < group; ++i) {
+				slots[i] = home(isbns[first + i]);
+				prefetch(&slots_[slots[i]]);
+			}
+			for (size_t i = 0; i < group; ++i) {
+				slots[i] = probe(isbns[first + i], slots[i]);
+				if (slots_[slots[i]].entry != none) {
+					prefetch(&entries_[slots_[slots[i]].entry]);
+				}
+			}
+			//moving an entry to the front touches its neighbours in the recency list
+			for (size_t i = 0; i < group; ++i) {
+				if (slots_[slots[i]].entry != none) {
+					const Entry& entry = entries_[slots_[slots[i]].entry];
+					prefetch(&entries_[entry.prev]);
+					prefetch(&entries_[entry.next]);
+				}
+			}
+			//lookups don't change the table so the slots found are still right
+			for (size_t i = 0; i < group; ++i) {
+				uint32_t entry = slots_[slots[i]].entry;
+				found[first + i] = entry != none;
+				if (entry == none) {
+					++stats_.misses;
+					continue;
+				}
+				++stats_.hits;
+				++hits;
+				prices[first + i] = entries_[entry].price;
+				moveToFront(entry);
+			}
+		}
+		return hits;
+	}
+	//Inserts count isbns with their prices, same as calling insert for each one in order
+	void insert_batch(const int* isbns, const int* prices, size_t count) {
+		for (size_t first = 0; first < count; first += batchGroup) {
+			size_t group = min(batchGroup, count - first);
+			for (size_t i = 0; i < group; ++i) {
+				prefetch(&slots_[home(isbns[first + i])]);
+			}
+			for (size_t i = 0; i < group; ++i) {
+				insert(isbns[first + i], prices[first + i]);
+			}
+		}
+	}
+	size_t size() const {
+		return size_;
+	}
+	const CacheStats& stats() const {
+		return stats_;
+	}
+	void resetStats() {
+		stats_ = CacheStats();
+	}
+private:
+	struct Entry {
+		int isbn;
+		int price;
+		uint32_t prev;
+		uint32_t next;
+	};
+	//the key is kept in the slot too so that probing doesn't touch the entries
+	struct Slot {
+		int isbn;
+		uint32_t entry;
+	};
+	static constexpr uint32_t none = 0xFFFFFFFF;
+	static constexpr uint32_t head = static_cast<uint32_t>(Capacity);
+
+	vector<Entry> entries_;
+	vector<Slot> slots_;
+	uint32_t free_;
+	size_t size_ = 0;
+	CacheStats stats_;
+
+	//power of two with at least twice as many slots as entries, so probe sequences stay short
+	static size_t tableSize() {
+		size_t size = 1;
+		while (size < 2 * Capacity) {
+			size *= 2;
+		}
+		return size;
+	}
+	size_t home(int isbn) const {
+		uint64_t hash = static_cast<uint64_t>(static_cast<unsigned int>(isbn)) * 0x9E3779B97F4A7C15ull;
+		return static_cast<size_t>(hash >> 32) & (slots_.size() - 1);
+	}
+	//slot holding the isbn or the empty slot ending its probe sequence
+	size_t find(int isbn) const {
+		return probe(isbn, home(isbn));
+	}
+	size_t probe(int isbn, size_t slot) const {
+		while (slots_[slot].entry != none && slots_[slot].isbn != isbn) {
+			slot = (slot + 1) & (slots_.size() - 1);
+		}
+		return slot;
+	}
+	//how many isbns of a batch are in flight at once, their slots and entries have to fit the L1 cache
+	static constexpr size_t batchGroup = 32;
+	static constexpr size_t minBatchGroup = 16;
+	static void prefetch(const void* address) {
+#if defined(_MSC_VER)
+		_mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+		__builtin_prefetch(address);
+#endif
+	}
+	//backward shift deletion: moves later slots of the cluster up so no probe sequence gets broken
+	void removeSlot(size_t slot) {
+		const size_t mask = slots_.size() - 1;
+		size_t next = (slot + 1) & mask;
+		while (slots_[next].entry != none) {
+			size_t wanted = home(slots_[next].isbn);
+			//the slot can move back if its home isn't cyclically within (slot, next]
+			if (((next - wanted) & mask) >= ((next - slot) & mask)) {
+				slots_[slot] = slots_[next];
+				slot = next;
+			}
+			next = (next + 1) & mask;
+		}
+		slots_[slot].entry = none;
+	}
+
+	void unlink(uint32_t entry) {
+		entries_[entries_[entry].prev].next = entries_[entry].next;
+		entries_[entries_[entry].next].prev = entries_[entry].prev;
+	}
+	//inserts the entry in the begginging of the queue
+	void link(uint32_t entry) {
+		entries_[entry].prev = head;
+		entries_[entry].next = entries_[head].next;
+		entries_[entries_[head].next].prev = entry;
+		entries_[head].next = entry;
+	}
+	void moveToFront(uint32_t entry) {
+		if (entries_[head].next != entry) {
+			unlink(entry);
+			link(entry);
+		}
+	}
+};
+
+//Clock of the shards of a ShardedLRUCache, they all read the one clock the cache owns
+template<typename Clock>
+class SharedClock {
+public:
+	explicit SharedClock(const Clock* clock = nullptr) :clock_{ clock }
+	{}
+	uint64_t now() const {
+		return clock_->now();
+	}
+private:
+	const Clock* clock_;
+};
+
+/*
+LRUCache safe to share between threads
+Keys are hashed to Shards independent LRUCaches, each with its own lock, map and recency list,
+so threads working on different shards never wait for each other. lookup, insert and erase behave as
+for LRUCache but recency is tracked per shard: every shard holds Capacity / Shards (rounded up) entries
+and a full shard evicts the entry its own EvictionPolicy picks, even if another shard has older ones.
+
+get_or_load deduplicates misses (single flight): while the loader of a missing isbn runs, every other caller
+asking for the same isbn waits for that load instead of starting its own, and all of them get its result
+(or the exception it threw, nothing is cached then). With refreshAhead, a hit on an entry which expires within
+refreshAhead ticks returns the cached price and reloads the entry in the background, so hot entries
+are replaced before they expire instead of every caller missing on them at once.
+Background loads run on the pool given to the constructor, the destructor waits for them.
+Time to live is counted on a single Clock which all the shards read, clock() gives access to it
+(a ManualClock advanced there moves every shard).
+*/
+template<size_t Capacity, size_t Shards = 16, template<size_t> class EvictionPolicy = LRUEviction, typename Clock = SteadyClock>
+class ShardedLRUCache {
+public:
+	static_assert(Shards > 0 && (Shards & (Shards - 1)) == 0, "Shards has to be a power of two");
+	static constexpr size_t ShardCapacity = (Capacity + Shards - 1) / Shards;
+	typedef LRUCache<ShardCapacity, EvictionPolicy, SharedClock<Clock>> ShardCache;
+
+	explicit ShardedLRUCache(WorkStealingPool& pool = WorkStealingPool::shared()) :ShardedLRUCache(Clock(), pool)
+	{}
+	explicit ShardedLRUCache(Clock clock, WorkStealingPool& pool = WorkStealingPool::shared())
+		:clock_{ clock }, shards_(Shards), background_{ pool }
+	{
+		for (Shard& shard : shards_) {
+			shard.cache_.clock() = SharedClock<Clock>(&clock_);
+		}
+	}
+	ShardedLRUCache(const ShardedLRUCache& other) = delete;
+	ShardedLRUCache& operator=(const ShardedLRUCache& other) = delete;
+
+	bool lookup(int isbn, int *price) {
+		Shard& shard = shardOf(isbn);
+		lock_guard<mutex> lock(shard.mutex_);
+		return shard.cache_.lookup(isbn, price);
+	}
+	void insert(int isbn, int p, uint64_t ttl = ShardCache::noExpiry) {
+		Shard& shard = shardOf(isbn);
+		lock_guard<mutex> lock(shard.mutex_);
+		shard.cache_.insert(isbn, p, ttl);
+	}
+	bool erase(int isbn) {
+		Shard& shard = shardOf(isbn);
+		lock_guard<mutex> lock(shard.mutex_);
+		return shard.cache_.erase(isbn);
+	}
+	/*
+	Returns the price of the isbn, calling loader(isbn) -> int to get it and inserting it with ttl if it isn't cached
+	Only one loader runs per missing isbn at a time, concurrent callers for it wait for its result
+	Rethrows the exception of the loader if it threw
+	*/
+	template<typename Loader>
+	int get_or_load(int isbn, Loader loader, uint64_t ttl = ShardCache::noExpiry, uint64_t refreshAhead = 0) {
+		Shard& shard = shardOf(isbn);
+		shared_ptr<promise<int>> load;
+		shared_future<int> result;
+		{
+			lock_guard<mutex> lock(shard.mutex_);
+			int price;
+			if (hit(shard, isbn, &price, loader, ttl, refreshAhead)) {
+				return price;
+			}
+			result = join(shard, isbn, load);
+		}
+		if (load) {
+			//the first caller loads it itself
+			complete(shard, isbn, loader, ttl, *load, false);
+		}
+		return result.get();
+	}
+	//same as get_or_load but the loader runs in the background, the future gets the price
+	template<typename Loader>
+	shared_future<int> get_or_load_async(int isbn, Loader loader, uint64_t ttl = ShardCache::noExpiry, uint64_t refreshAhead = 0) {
+		Shard& shard = shardOf(isbn);
+		lock_guard<mutex> lock(shard.mutex_);
+		int price;
+		if (hit(shard, isbn, &price, loader, ttl, refreshAhead)) {
+			promise<int> ready;
+			ready.set_value(price);
+			return ready.get_future().share();
+		}
+		shared_ptr<promise<int>> load;
+		shared_future<int> result = join(shard, isbn, load);
+		if (load) {
+			background_.run([this, &shard, isbn, loader, ttl, load]() mutable {
+				complete(shard, isbn, loader, ttl, *load, false);
+			});
+		}
+		return result;
+	}
+
+	/*
+	Writes the entries to the file at path, shard after shard in the order of their policies
+	Each shard is locked only while its entries are copied, the file is written without any lock held
+	Throws if the file can't be written
+	*/
+	void save(const string& path) {
+		vector<CacheEntry> entries;
+		for (Shard& shard : shards_) {
+			lock_guard<mutex> lock(shard.mutex_);
+			shard.cache_.copyEntries(entries);
+		}
+		CacheSnapshot::write(entries, path);
+	}
+	//same as save but in the background, the future is ready (or has the exception) once the file is written
+	shared_future<void> save_async(const string& path) {
+		shared_ptr<promise<void>> saved = make_shared<promise<void>>();
+		background_.run([this, path, saved] {
+			try {
+				save(path);
+				saved->set_value();
+			}
+			catch (...) {
+				saved->set_exception(current_exception());
+			}
+		});
+		return saved->get_future().share();
+	}
+	//Inserts the entries saved in the file at path, see LRUCache::load. Throws if the file can't be read
+	void load(const string& path) {
+		vector<CacheEntry> entries = CacheSnapshot::read(path);
+		for (const CacheEntry& entry : entries) {
+			insert(entry.isbn, entry.price, entry.ttl);
+		}
+	}
+
+	//waits for the loads, refreshes and saves started in the background so far, what they loaded is cached by then
+	void wait_background() {
+		background_.wait();
+	}
+
+	Clock& clock() {
+		return clock_;
+	}
+	//sum of the stats of the shards, each one read under its lock
+	CacheStats stats() {
+		CacheStats total;
+		for (Shard& shard : shards_) {
+			lock_guard<mutex> lock(shard.mutex_);
+			total += shard.cache_.stats();
+		}
+		return total;
+	}
+private:
+	//a cache line of its own so that the locks of neighbouring shards don't share one
+	struct alignas(64) Shard {
+		mutex mutex_;
+		ShardCache cache_;
+		//results of the loads in progress
+		unordered_map<int, shared_future<int>> loading_;
+	};
+	//before the shards, which point to it
+	Clock clock_;
+	vector<Shard> shards_;
+	//last, so that it waits for the background loads before the shards are destroyed
+	TaskGroup background_;
+
+	//looks the isbn up with the shard locked, starting a refresh if it expires soon
+	template<typename Loader>
+	bool hit(Shard& shard, int isbn, int* price, const Loader& loader, uint64_t ttl, uint64_t refreshAhead) {
+		uint64_t expiry;
+		if (!shard.cache_.lookup(isbn, price, &expiry)) {
+			return false;
+		}
+		if (refreshAhead != 0 && expiry != ShardCache::noExpiry && expiry <= shard.cache_.clock().now() + refreshAhead &&
+			shard.loading_.count(isbn) == 0) {
+			shared_ptr<promise<int>> load = make_shared<promise<int>>();
+			shard.loading_[isbn] = load->get_future().share();
+			background_.run([this, &shard, isbn, loader, ttl, load]() mutable {
+				complete(shard, isbn, loader, ttl, *load, true);
+			});
+		}
+		return true;
+	}
+	//with the shard locked, returns the result of the load of the isbn in progress or starts one, setting load
+	shared_future<int> join(Shard& shard, int isbn, shared_ptr<promise<int>>& load) {
+		auto flight = shard.loading_.find(isbn);
+		if (flight != shard.loading_.end()) {
+			return flight->second;
+		}
+		load = make_shared<promise<int>>();
+		return shard.loading_[isbn] = load->get_future().share();
+	}
+	/*
+	Runs the loader and publishes its result, replacing the cached entry when refreshing
+	Whether the loader or the insert throws, the load is always taken out of loading_ and the promise always gets
+	the price or the exception, waiters never see a broken promise and later callers start a new load
+	*/
+	template<typename Loader>
+	void complete(Shard& shard, int isbn, Loader& loader, uint64_t ttl, promise<int>& load, bool refresh) {
+		int price;
+		try {
+			price = loader(isbn);
+			lock_guard<mutex> lock(shard.mutex_);
+			if (refresh) {
+				shard.cache_.erase(isbn);
+			}
+			shard.cache_.insert(isbn, price, ttl);
+			shard.loading_.erase(isbn);
+		}
+		catch (...) {
+			{
+				lock_guard<mutex> lock(shard.mutex_);
+				shard.loading_.erase(isbn);
+			}
+			load.set_exception(current_exception());
+			return;
+		}
+		load.set_value(price);
+	}
+
+	//isbns are often consecutive, multiplying by 2^64/golden ratio spreads them and the top bits pick the shard
+	Shard& shardOf(int isbn) {
+		uint64_t hash = static_cast<uint64_t>(static_cast<unsigned int>(isbn)) * 0x9E3779B97F4A7C15ull;
+		return shards_[static_cast<size_t>(hash >> 32) & (Shards - 1)];
+	}
+};
@@ -0,0 +1,60 @@
+#include "stdafx.h"
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "LRU_Cache.h"
+
+using namespace std;
+
+/*
+Replays a trace of isbns through LRUCache with every eviction policy and prints the hit ratios for capacities 2^6 to 2^20
+	LRU_Replay trace.txt
+The trace is the requested isbns separated by white space, in the order they were requested.
+Every request is a lookup followed by an insert when the lookup missed, the way the cache is used in front of the backend.
+*/
+template<size_t Capacity, template<size_t> class EvictionPolicy>
+double replay(const vector<int>& trace) {
+	//on the heap, the big caches don't fit the stack
+	unique_ptr<LRUCache<Capacity, EvictionPolicy>> cache(new LRUCache<Capacity, EvictionPolicy>());
+	int price;
+	for (int isbn : trace) {
+		if (!cache->lookup(isbn, &price)) {
+			cache->insert(isbn, 0);
+		}
+	}
+	return cache->stats().hitRatio();
+}
+
+template<size_t Capacity>
+void printRow(const vector<int>& trace) {
+	printf("%10zu %9.4f %9.4f %9.4f %9.4f\n", Capacity, replay<Capacity, LRUEviction>(trace), replay<Capacity, ClockEviction>(trace),
+		replay<Capacity, S3FIFOEviction>(trace), replay<Capacity, WTinyLFUEviction>(trace));
+}
+
+template<size_t... Exponents>
+void printTable(const vector<int>& trace, index_sequence<Exponents...>) {
+	printf("%10s %9s %9s %9s %9s\n", "capacity", "LRU", "CLOCK", "S3-FIFO", "W-TinyLFU");
+	(printRow<size_t(1) << (Exponents + 6)>(trace), ...);
+}
+
+int main(int argc, char* argv[]) {
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s trace.txt\n", argv[0]);
+		return 1;
+	}
+	ifstream file(argv[1]);
+	if (!file) {
+		fprintf(stderr, "cannot open %s\n", argv[1]);
+		return 1;
+	}
+	vector<int> trace;
+	int isbn;
+	while (file >> isbn) {
+		trace.push_back(isbn);
+	}
+	printf("%zu requests\n", trace.size());
+	printTable(trace, make_index_sequence<15>());
+	return 0;
+}
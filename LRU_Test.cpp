@@ -0,0 +1,728 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "LRU_Cache.h"
+
+using namespace std;
+
+/*
+Checks of the caches, exits with 1 on the first failure
+	LRU_Test
+The loader checks run with sleeping fake loaders and take about a quarter of a second.
+*/
+bool check(bool condition, const char* what) {
+	if (!condition) {
+		fprintf(stderr, "FAILED: %s\n", what);
+	}
+	return condition;
+}
+
+//the shards of a ShardedLRUCache all read the clock of the cache, advancing it expires entries in every shard
+bool shardedExpiry() {
+	typedef ShardedLRUCache<64, 4, LRUEviction, ManualClock> Cache;
+	ManualClock start;
+	start.advance(1000);
+	Cache cache(start);
+	if (!check(cache.clock().now() == 1000, "the cache starts from the clock it was given")) {
+		return false;
+	}
+	//even isbns expire after 100 ticks, odd ones never
+	for (int isbn = 0; isbn < 32; ++isbn) {
+		cache.insert(isbn, isbn, isbn % 2 == 0 ? 100 : Cache::ShardCache::noExpiry);
+	}
+	cache.clock().advance(99);
+	int found = 0;
+	int price;
+	for (int isbn = 0; isbn < 32; ++isbn) {
+		found += cache.lookup(isbn, &price);
+	}
+	if (!check(found == 32, "nothing expires before its time")) {
+		return false;
+	}
+	cache.clock().advance(1);
+	bool expired = true;
+	for (int isbn = 0; isbn < 32; ++isbn) {
+		expired &= cache.lookup(isbn, &price) == (isbn % 2 == 1);
+	}
+	return check(expired, "entries expire in every shard") && check(cache.stats().expirations == 16, "every expiration is counted");
+}
+
+//a slow loader, every caller missing the same isbn at once has to wait for its single load
+bool singleFlight(WorkStealingPool& pool) {
+	ShardedLRUCache<1000, 8> cache(pool);
+	atomic<int> loads{ 0 };
+	auto loader = [&loads](int isbn) {
+		++loads;
+		this_thread::sleep_for(chrono::milliseconds(50));
+		return isbn * 10;
+	};
+	atomic<int> wrong{ 0 };
+	vector<thread> callers;
+	for (int i = 0; i < 32; ++i) {
+		callers.emplace_back([&cache, &loader, &wrong] {
+			if (cache.get_or_load(7, loader) != 70) {
+				++wrong;
+			}
+		});
+	}
+	for (thread& caller : callers) {
+		caller.join();
+	}
+	int price = 0;
+	if (!check(loads == 1, "32 concurrent misses load once") || !check(wrong == 0, "every caller gets the loaded price") ||
+		!check(cache.lookup(7, &price) && price == 70, "the loaded price is cached")) {
+		return false;
+	}
+	//the exception of a failing load reaches every waiter and nothing is cached
+	loads = 0;
+	atomic<int> failures{ 0 };
+	auto failing = [&loads](int) -> int {
+		++loads;
+		this_thread::sleep_for(chrono::milliseconds(50));
+		throw runtime_error("backend down");
+	};
+	callers.clear();
+	for (int i = 0; i < 8; ++i) {
+		callers.emplace_back([&cache, &failing, &failures] {
+			try {
+				cache.get_or_load(8, failing);
+			}
+			catch (const runtime_error&) {
+				++failures;
+			}
+		});
+	}
+	for (thread& caller : callers) {
+		caller.join();
+	}
+	if (!check(loads == 1, "a failing load runs once") || !check(failures == 8, "every waiter sees the exception") ||
+		!check(!cache.lookup(8, &price), "a failed load caches nothing")) {
+		return false;
+	}
+	loads = 0;
+	shared_future<int> first = cache.get_or_load_async(9, loader);
+	shared_future<int> second = cache.get_or_load_async(9, loader);
+	return check(first.get() == 90 && second.get() == 90, "async callers get the loaded price") &&
+		check(cache.get_or_load_async(9, loader).get() == 90 && loads == 1, "async callers share one load");
+}
+
+//a hit within refreshAhead ticks of the expiry returns the cached price and reloads the entry in the background,
+//only the ManualClock moves the time and the reload is waited for, nothing depends on how long a thread sleeps
+bool refreshAhead(WorkStealingPool& pool) {
+	ShardedLRUCache<1000, 8, LRUEviction, ManualClock> cache(pool);
+	atomic<int> loads{ 0 };
+	auto loader = [&loads](int) {
+		return ++loads;
+	};
+	if (!check(cache.get_or_load(11, loader, 100, 20) == 1, "the first call loads")) {
+		return false;
+	}
+	cache.clock().advance(50);
+	if (!check(cache.get_or_load(11, loader, 100, 20) == 1 && loads == 1, "a hit far from the expiry doesn't reload")) {
+		return false;
+	}
+	cache.clock().advance(35);
+	if (!check(cache.get_or_load(11, loader, 100, 20) == 1, "a hit close to the expiry returns the cached price")) {
+		return false;
+	}
+	cache.wait_background();
+	if (!check(cache.get_or_load(11, loader, 100, 20) == 2 && loads == 2, "the entry is reloaded once in the background")) {
+		return false;
+	}
+	//reloaded at 85, it expires at 185 instead of 100
+	cache.clock().advance(65);
+	return check(cache.get_or_load(11, loader, 100, 20) == 2 && loads == 2, "the reloaded entry lives a full ttl");
+}
+
+//a header whose count times the entry size wraps around to 0 matches the size of an empty file, read must still reject it
+bool forgedSnapshot() {
+	const char* path = "LRU_Test.snapshot";
+	{
+		ofstream file(path, ios::binary | ios::trunc);
+		uint32_t version = CacheSnapshot::formatVersion;
+		uint32_t reserved = 0;
+		uint64_t count = (uint64_t(1) << 63) / sizeof(CacheEntry) * 2;
+		file.write("LRUCACHE", 8);
+		file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+		file.write(reinterpret_cast<const char*>(&reserved), sizeof(reserved));
+		file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+	}
+	bool rejected = false;
+	try {
+		CacheSnapshot::read(path);
+	}
+	catch (const char*) {
+		rejected = true;
+	}
+	remove(path);
+	return check(rejected, "a snapshot with an overflowing count is rejected");
+}
+
+/*
+FlatLRUCache against LRUCache on random lookups, inserts, erases and insert_batch calls of isbns from a range three times
+the capacity, so both evict all the time: every call returns the same, the prices are the same and so are the counters
+*/
+bool flatEquivalence() {
+	const int range = 192;
+	mt19937 random(4);
+	FlatLRUCache<64> flat;
+	LRUCache<64> cache;
+	for (int op = 0; op < 50000; ++op) {
+		int isbn = random() % range;
+		unsigned choice = random() % 8;
+		if (choice < 3) {
+			int flatPrice = -1;
+			int price = -1;
+			if (!check(flat.lookup(isbn, &flatPrice) == cache.lookup(isbn, &price) && flatPrice == price, "lookup finds the same price")) {
+				return false;
+			}
+		}
+		else if (choice < 6) {
+			flat.insert(isbn, op);
+			cache.insert(isbn, op);
+		}
+		else if (choice == 6) {
+			if (!check(flat.erase(isbn) == cache.erase(isbn), "erase removes the same isbns")) {
+				return false;
+			}
+		}
+		else {
+			int isbns[40];
+			int prices[40];
+			size_t count = random() % 40;
+			for (size_t i = 0; i < count; ++i) {
+				isbns[i] = random() % range;
+				prices[i] = op;
+				cache.insert(isbns[i], prices[i]);
+			}
+			flat.insert_batch(isbns, prices, count);
+		}
+	}
+	//in the order of the isbns, the lookups touch both caches the same way
+	bool same = true;
+	for (int isbn = 0; isbn < range; ++isbn) {
+		int flatPrice = -1;
+		int price = -1;
+		same &= flat.lookup(isbn, &flatPrice) == cache.lookup(isbn, &price) && flatPrice == price;
+	}
+	const CacheStats& flatStats = flat.stats();
+	const CacheStats& stats = cache.stats();
+	return check(same && flat.size() == 64, "both caches hold the same isbns and prices") &&
+		check(flatStats.hits == stats.hits && flatStats.misses == stats.misses && flatStats.inserts == stats.inserts &&
+			flatStats.evictions == stats.evictions, "both caches count the same");
+}
+
+/*
+Of 30 hot isbns looked up 5 times each, followed by 70 isbns used once which fill the cache up to its 100 entries,
+how many are still cached after a scan of scan more isbns used once
+*/
+template<template<size_t> class EvictionPolicy>
+int hotAfterScan(int scan) {
+	const int hot = 30;
+	LRUCache<100, EvictionPolicy> cache;
+	int price;
+	for (int round = 0; round < 5; ++round) {
+		for (int isbn = 0; isbn < hot; ++isbn) {
+			if (!cache.lookup(isbn, &price)) {
+				cache.insert(isbn, isbn);
+			}
+		}
+	}
+	for (int isbn = 1000; isbn < 1000 + 70 + scan; ++isbn) {
+		if (!cache.lookup(isbn, &price)) {
+			cache.insert(isbn, isbn);
+		}
+	}
+	//copyEntries doesn't count as a use, lookups would
+	vector<CacheEntry> entries;
+	cache.copyEntries(entries);
+	return static_cast<int>(count_if(entries.begin(), entries.end(), [hot](const CacheEntry& entry) { return entry.isbn < hot; }));
+}
+
+/*
+A scan shorter than the entries used once flushes the hot isbns out of LRUEviction, the others keep them.
+CLOCK only gives them one sweep of the hand, a scan as long as the cache flushes it too, S3-FIFO and W-TinyLFU hold out
+*/
+bool scanResistance() {
+	return check(hotAfterScan<LRUEviction>(60) == 0, "a scan flushes the hot isbns out of LRUEviction") &&
+		check(hotAfterScan<ClockEviction>(60) >= 25, "ClockEviction keeps the hot isbns through a short scan") &&
+		check(hotAfterScan<S3FIFOEviction>(60) >= 25, "S3FIFOEviction keeps the hot isbns through a short scan") &&
+		check(hotAfterScan<WTinyLFUEviction>(60) >= 25, "WTinyLFUEviction keeps the hot isbns through a short scan") &&
+		check(hotAfterScan<S3FIFOEviction>(1000) >= 25, "S3FIFOEviction keeps the hot isbns through a long scan") &&
+		check(hotAfterScan<WTinyLFUEviction>(1000) >= 25, "WTinyLFUEviction keeps the hot isbns through a long scan");
+}
+
+/*
+Drives a policy the way LRUCache does with random inserts (evicting first when full), touches and erases,
+for_each has to visit exactly the keys it tracks, each once. Erased keys come back often, also right after the erase
+*/
+template<template<size_t> class EvictionPolicy>
+bool policyKeys(unsigned seed) {
+	const size_t capacity = 64;
+	EvictionPolicy<capacity> policy;
+	map<int, typename EvictionPolicy<capacity>::handle> tracked;
+	mt19937 random(seed);
+	for (int op = 0; op < 20000; ++op) {
+		int isbn = random() % 200;
+		auto it = tracked.find(isbn);
+		unsigned choice = random() % 4;
+		if (it == tracked.end()) {
+			if (tracked.size() == capacity) {
+				auto evicted = tracked.find(policy.evict());
+				if (!check(evicted != tracked.end(), "evict returns a tracked key")) {
+					return false;
+				}
+				tracked.erase(evicted);
+			}
+			tracked[isbn] = policy.insert(isbn);
+		}
+		else if (choice < 2) {
+			policy.touch(it->second);
+		}
+		else {
+			policy.erase(it->second);
+			tracked.erase(it);
+			if (choice == 3) {
+				tracked[isbn] = policy.insert(isbn);
+			}
+		}
+		if (op % 100 == 0 || op > 19900) {
+			vector<int> visited;
+			policy.for_each([&visited](int key) {
+				visited.push_back(key);
+			});
+			sort(visited.begin(), visited.end());
+			bool same = visited.size() == tracked.size();
+			auto key = tracked.begin();
+			for (size_t i = 0; same && i < visited.size(); ++i, ++key) {
+				same = visited[i] == key->first;
+			}
+			if (!check(same, "for_each visits every tracked key once")) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+//an erased isbn inserted again is found with its new price, also once the cache has evicted around it
+template<template<size_t> class EvictionPolicy>
+bool eraseReinsert() {
+	LRUCache<8, EvictionPolicy> cache;
+	for (int isbn = 0; isbn < 8; ++isbn) {
+		cache.insert(isbn, isbn);
+	}
+	int price = 0;
+	if (!check(cache.erase(3) && !cache.lookup(3, &price) && !cache.erase(3), "an erased isbn is gone")) {
+		return false;
+	}
+	cache.insert(3, 30);
+	if (!check(cache.lookup(3, &price) && price == 30, "an erased isbn inserted again has its new price")) {
+		return false;
+	}
+	for (int round = 0; round < 100; ++round) {
+		int isbn = 100 + round;
+		cache.insert(isbn, round);
+		if (!check(cache.erase(isbn) && !cache.lookup(isbn, &price), "an isbn is erased right after its insert")) {
+			return false;
+		}
+		cache.insert(isbn, -round);
+		if (!check(cache.lookup(isbn, &price) && price == -round, "the isbn is found again after its reinsert")) {
+			return false;
+		}
+	}
+	vector<CacheEntry> entries;
+	cache.copyEntries(entries);
+	return check(entries.size() == 8 && cache.stats().evictions == 100, "the cache stays full and evicts once for every new isbn");
+}
+
+bool evictionPolicies() {
+	return scanResistance() &&
+		policyKeys<LRUEviction>(1) && policyKeys<ClockEviction>(2) && policyKeys<S3FIFOEviction>(3) && policyKeys<WTinyLFUEviction>(4) &&
+		eraseReinsert<LRUEviction>() && eraseReinsert<ClockEviction>() && eraseReinsert<S3FIFOEviction>() && eraseReinsert<WTinyLFUEviction>();
+}
+
+/*
+Random timers against a std::multimap of their expiries, from a few ticks to past the 64^4 ticks the levels cover,
+so they are cascaded down through every level and the overflow list, some are cancelled on the way.
+The clock moves by single ticks, by hundreds and by jumps over whole rotations of the higher levels,
+every advance has to expire exactly the timers due after the previous one and up to its time
+*/
+bool timerWheelCascades() {
+	const uint64_t ranges[] = { 64, 4096, 262144, 16777216, 40000000 };
+	mt19937_64 random(5);
+	TimerWheel wheel;
+	multimap<uint64_t, int> expected;
+	map<int, TimerWheel::handle> handles;
+	uint64_t now = 0;
+	int next = 0;
+	for (int op = 0; op < 20000; ++op) {
+		unsigned choice = random() % 8;
+		if (choice < 4) {
+			uint64_t expiry = now + 1 + random() % ranges[random() % 5];
+			handles[next] = wheel.schedule(next, expiry);
+			expected.emplace(expiry, next++);
+		}
+		else if (choice == 4 && !handles.empty()) {
+			auto cancelled = handles.lower_bound(static_cast<int>(random() % next));
+			if (cancelled == handles.end()) {
+				cancelled = handles.begin();
+			}
+			uint64_t expiry = TimerWheel::expiry(cancelled->second);
+			auto entry = expected.equal_range(expiry).first;
+			while (entry->second != cancelled->first) {
+				++entry;
+			}
+			expected.erase(entry);
+			wheel.cancel(cancelled->second);
+			handles.erase(cancelled);
+		}
+		else {
+			unsigned step = random() % 16;
+			now += step < 8 ? 1 : step < 14 ? random() % 300 : random() % 300000;
+			vector<int> expired;
+			wheel.advance(now, [&expired](int timer) {
+				expired.push_back(timer);
+			});
+			vector<int> due;
+			while (!expected.empty() && expected.begin()->first <= now) {
+				due.push_back(expected.begin()->second);
+				handles.erase(expected.begin()->second);
+				expected.erase(expected.begin());
+			}
+			sort(expired.begin(), expired.end());
+			sort(due.begin(), due.end());
+			if (!check(expired == due, "an advance expires the timers due by then and no others")) {
+				return false;
+			}
+		}
+	}
+	//the rest, including the overflow list, in one jump
+	size_t rest = 0;
+	wheel.advance(now + 50000000, [&rest](int) {
+		++rest;
+	});
+	return check(rest == expected.size() && wheel.empty(), "every timer which wasn't cancelled expires");
+}
+
+//entries of a single LRUCache expire at their ttl, also one cascaded down from the higher levels of the wheel
+bool cacheTtl() {
+	LRUCache<16, LRUEviction, ManualClock> cache;
+	cache.insert(1, 10, 100);
+	cache.insert(2, 20, 300000);
+	cache.insert(3, 30);
+	int price = 0;
+	uint64_t expiry = 0;
+	if (!check(cache.lookup(1, &price, &expiry) && price == 10 && expiry == 100, "lookup gives the tick an entry expires at") ||
+		!check(cache.lookup(3, &price, &expiry) && expiry == cache.noExpiry, "an entry without a ttl doesn't expire")) {
+		return false;
+	}
+	cache.clock().advance(99);
+	//inserting an isbn which is cached already keeps its expiry
+	cache.insert(1, 11, 1000);
+	if (!check(cache.lookup(1, &price, &expiry) && price == 10 && expiry == 100, "an insert of a cached isbn keeps its price and expiry")) {
+		return false;
+	}
+	cache.clock().advance(1);
+	if (!check(!cache.lookup(1, &price) && cache.lookup(2, &price) && cache.lookup(3, &price), "an entry expires at its ttl") ||
+		!check(cache.stats().expirations == 1, "the expiration is counted")) {
+		return false;
+	}
+	cache.insert(1, 12, 50);
+	cache.clock().advance(299899);
+	if (!check(!cache.lookup(1, &price) && cache.lookup(2, &price), "a reinserted entry expires at its new ttl")) {
+		return false;
+	}
+	cache.clock().advance(1);
+	return check(!cache.lookup(2, &price) && cache.lookup(3, &price), "an entry 300000 ticks out expires on time") &&
+		check(cache.stats().expirations == 3 && cache.stats().evictions == 0, "expired entries are removed, not evicted");
+}
+
+/*
+A known sequence on a cache of 4 entries: 4 inserts, a hit, a miss, an insert of a cached isbn (not counted),
+an evicting insert, a miss on the evicted isbn, a hit, an erase (not counted) and an insert into the room it made
+*/
+template<typename Cache>
+bool countedSequence(Cache& cache, const char* what) {
+	int price;
+	for (int isbn = 1; isbn <= 4; ++isbn) {
+		cache.insert(isbn, isbn);
+	}
+	cache.lookup(1, &price);
+	cache.lookup(5, &price);
+	cache.insert(2, 2);
+	//1 and 2 were used since 3 was inserted, 3 is the least recently used
+	cache.insert(5, 5);
+	cache.lookup(3, &price);
+	cache.lookup(2, &price);
+	cache.erase(4);
+	cache.insert(6, 6);
+	CacheStats stats = cache.stats();
+	return check(stats.hits == 2 && stats.misses == 2 && stats.inserts == 6 && stats.evictions == 1 && stats.expirations == 0 &&
+		stats.hitRatio() == 0.5, what);
+}
+
+//the counters of every cache after the known sequence, expirations of entries with a ttl and resetStats
+bool cacheStats() {
+	LRUCache<4> cache;
+	FlatLRUCache<4> flat;
+	ShardedLRUCache<4, 1> sharded;
+	if (!countedSequence(cache, "LRUCache counts the known sequence") || !countedSequence(flat, "FlatLRUCache counts the known sequence") ||
+		!countedSequence(sharded, "ShardedLRUCache counts the known sequence")) {
+		return false;
+	}
+	cache.resetStats();
+	flat.resetStats();
+	const CacheStats& reset = cache.stats();
+	if (!check(reset.hits == 0 && reset.misses == 0 && reset.inserts == 0 && reset.evictions == 0 && reset.hitRatio() == 0, "resetStats zeroes the counters") ||
+		!check(flat.stats().hits == 0 && flat.stats().inserts == 0, "resetStats of FlatLRUCache zeroes the counters")) {
+		return false;
+	}
+	LRUCache<4, LRUEviction, ManualClock> expiring;
+	expiring.insert(1, 1, 10);
+	expiring.insert(2, 2, 10);
+	expiring.insert(3, 3);
+	expiring.clock().advance(10);
+	int price;
+	expiring.lookup(1, &price);
+	expiring.lookup(3, &price);
+	const CacheStats& stats = expiring.stats();
+	//2 expires along with 1, it is removed by the wheel before the lookup of 1
+	return check(stats.expirations == 2 && stats.misses == 1 && stats.hits == 1 && stats.inserts == 3 && stats.evictions == 0,
+		"expired entries count as expirations and their lookups as misses");
+}
+
+/*
+lookup_batch on one cache against a loop of lookup on another one with the same contents: the same prices, found flags
+and number of hits, and the same recency order afterwards (the inserts which follow evict the same isbns).
+The batches are of size 1, of sizes around the groups of 32 and the tail of fewer than 16 looked up one by one,
+with isbns which are missing and isbns which come twice in a batch
+*/
+bool lookupBatch() {
+	const int range = 600;
+	FlatLRUCache<256> batched;
+	FlatLRUCache<256> looped;
+	mt19937 random(6);
+	for (int isbn = 0; isbn < 256; ++isbn) {
+		batched.insert(isbn * 2, isbn);
+		looped.insert(isbn * 2, isbn);
+	}
+	const size_t sizes[] = { 1, 1, 15, 16, 31, 32, 33, 47, 48, 64, 100, 257 };
+	for (int round = 0; round < 200; ++round) {
+		size_t count = round < 12 ? sizes[round] : 1 + random() % 300;
+		vector<int> isbns(count);
+		for (int& isbn : isbns) {
+			isbn = random() % range;
+		}
+		//the first batch of size 1 is a missing isbn, the second one a cached isbn
+		if (round < 2) {
+			isbns[0] = round == 0 ? 1 : 2;
+		}
+		vector<int> prices(count, -1);
+		//vector<bool> has no array of bool to hand out
+		unique_ptr<bool[]> found(new bool[count]);
+		size_t hits = batched.lookup_batch(isbns.data(), count, prices.data(), found.get());
+		size_t loopHits = 0;
+		bool same = true;
+		for (size_t i = 0; i < count; ++i) {
+			int price = -1;
+			bool hit = looped.lookup(isbns[i], &price);
+			loopHits += hit;
+			same &= found[i] == hit && (!hit || prices[i] == price);
+		}
+		if (!check(same && hits == loopHits, "lookup_batch finds the same prices as a loop of lookup")) {
+			return false;
+		}
+		//the inserts evict by recency, they only match if the batch touched the isbns in the same order
+		for (int i = 0; i < 8; ++i) {
+			int isbn = random() % range;
+			batched.insert(isbn, round);
+			looped.insert(isbn, round);
+		}
+	}
+	bool same = true;
+	for (int isbn = 0; isbn < range; ++isbn) {
+		int batchedPrice = -1;
+		int loopedPrice = -1;
+		same &= batched.lookup(isbn, &batchedPrice) == looped.lookup(isbn, &loopedPrice) && batchedPrice == loopedPrice;
+	}
+	return check(same, "both caches hold the same isbns after the batches") &&
+		check(batched.stats().hits == looped.stats().hits && batched.stats().misses == looped.stats().misses, "lookup_batch counts like lookup") &&
+		check(batched.lookup_batch(nullptr, 0, nullptr, nullptr) == 0, "an empty batch finds nothing");
+}
+
+//LRUEviction whose inserts throw while failInserts is set, like an allocation failing in the middle of LRUCache::insert
+bool failInserts = false;
+
+template<size_t Capacity>
+class FailingEviction : public LRUEviction<Capacity> {
+public:
+	typename LRUEviction<Capacity>::handle insert(int isbn) {
+		if (failInserts) {
+			throw runtime_error("out of memory");
+		}
+		return LRUEviction<Capacity>::insert(isbn);
+	}
+};
+
+//an insert throwing after the loader returned reaches the callers as the exception, not as a broken promise,
+//and the isbn isn't left loading or half cached: the next call loads it again
+bool failingInsert(WorkStealingPool& pool) {
+	ShardedLRUCache<64, 4, FailingEviction> cache(pool);
+	int loads = 0;
+	auto loader = [&loads](int isbn) {
+		++loads;
+		return isbn * 10;
+	};
+	failInserts = true;
+	bool thrown = false;
+	try {
+		cache.get_or_load(5, loader);
+	}
+	catch (const runtime_error&) {
+		thrown = true;
+	}
+	shared_future<int> async = cache.get_or_load_async(6, loader);
+	cache.wait_background();
+	bool asyncThrown = false;
+	try {
+		async.get();
+	}
+	catch (const runtime_error&) {
+		asyncThrown = true;
+	}
+	failInserts = false;
+	int price = 0;
+	return check(thrown && asyncThrown, "the exception of a failed insert reaches the caller") &&
+		check(!cache.lookup(5, &price) && !cache.lookup(6, &price), "a failed insert caches nothing") &&
+		check(cache.get_or_load(5, loader) == 50 && cache.get_or_load_async(6, loader).get() == 60 && loads == 4, "the next call loads again") &&
+		check(cache.stats().inserts == 2, "only the inserts which worked are counted");
+}
+
+bool sameEntries(const vector<CacheEntry>& a, const vector<CacheEntry>& b) {
+	if (a.size() != b.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < a.size(); ++i) {
+		if (a[i].isbn != b[i].isbn || a[i].price != b[i].price || a[i].ttl != b[i].ttl) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+A cache saved and loaded into a new one, whose clock is somewhere else, has the same entries in the same recency order
+with the same time left to live, so both evict the same isbn next. A smaller cache keeps the most recently used ones
+*/
+bool snapshotRoundTrip() {
+	const char* path = "LRU_Test.snapshot";
+	typedef LRUCache<8, LRUEviction, ManualClock> Cache;
+	Cache saved;
+	for (int isbn = 1; isbn <= 8; ++isbn) {
+		saved.insert(isbn, isbn * 100, isbn % 3 == 0 ? 1000 * isbn : Cache::noExpiry);
+	}
+	int price;
+	for (int isbn : { 5, 2, 8, 1 }) {
+		saved.lookup(isbn, &price);
+	}
+	saved.clock().advance(500);
+	saved.save(path);
+	ManualClock later;
+	later.advance(123456);
+	Cache loaded(later);
+	loaded.load(path);
+	LRUCache<3, LRUEviction, ManualClock> smaller;
+	smaller.load(path);
+	remove(path);
+	vector<CacheEntry> before;
+	vector<CacheEntry> after;
+	vector<CacheEntry> kept;
+	saved.copyEntries(before);
+	loaded.copyEntries(after);
+	smaller.copyEntries(kept);
+	if (!check(before.size() == 8 && sameEntries(before, after), "the loaded cache has the entries in the same order with the same time left") ||
+		!check(sameEntries(kept, vector<CacheEntry>(before.end() - 3, before.end())), "a smaller cache keeps the most recently used entries")) {
+		return false;
+	}
+	uint64_t expiry = 0;
+	if (!check(loaded.lookup(6, &price, &expiry) && price == 600 && expiry == 123456 + 5500, "a loaded entry expires as much later as it had left")) {
+		return false;
+	}
+	saved.lookup(6, &price);
+	saved.insert(100, 1);
+	loaded.insert(100, 1);
+	before.clear();
+	after.clear();
+	saved.copyEntries(before);
+	loaded.copyEntries(after);
+	return check(sameEntries(before, after), "both caches evict the same isbn");
+}
+
+//a snapshot cut short anywhere is rejected and the cache it was loaded into stays as it was
+bool truncatedSnapshot() {
+	const char* path = "LRU_Test.snapshot";
+	LRUCache<16> saved;
+	for (int isbn = 0; isbn < 10; ++isbn) {
+		saved.insert(isbn, isbn);
+	}
+	saved.save(path);
+	string bytes;
+	{
+		ifstream file(path, ios::binary);
+		bytes.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+	}
+	//empty, inside the header, the header alone, inside the first entry, a whole entry short and a byte short
+	const size_t cuts[] = { 0, 10, 24, 30, bytes.size() - sizeof(CacheEntry), bytes.size() - 1 };
+	bool rejected = bytes.size() == 24 + 10 * sizeof(CacheEntry);
+	for (size_t cut : cuts) {
+		{
+			ofstream file(path, ios::binary | ios::trunc);
+			file.write(bytes.data(), cut);
+		}
+		LRUCache<16> loaded;
+		loaded.insert(99, 99);
+		bool thrown = false;
+		try {
+			loaded.load(path);
+		}
+		catch (const char*) {
+			thrown = true;
+		}
+		vector<CacheEntry> entries;
+		loaded.copyEntries(entries);
+		rejected &= thrown && entries.size() == 1 && entries[0].isbn == 99;
+	}
+	remove(path);
+	return check(rejected, "a truncated snapshot is rejected and loads nothing");
+}
+
+int main() {
+	WorkStealingPool pool(2);
+	if (!shardedExpiry() || !singleFlight(pool) || !refreshAhead(pool) || !failingInsert(pool)) {
+		return 1;
+	}
+	if (!flatEquivalence() || !lookupBatch() || !evictionPolicies() || !cacheStats()) {
+		return 1;
+	}
+	if (!timerWheelCascades() || !cacheTtl()) {
+		return 1;
+	}
+	if (!forgedSnapshot() || !snapshotRoundTrip() || !truncatedSnapshot()) {
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
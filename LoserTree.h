@@ -0,0 +1,248 @@
+#pragma once
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+#include "WorkStealingPool.h"
+
+using namespace std;
+
+/*
+Tournament tree of losers over k sorted runs, each run is a [first, last) range of pointers
+The leaves are the heads of the runs, every internal node keeps the run which lost the match played there
+and the overall winner (the smallest head) is kept above the root. Taking the winner only replays
+the matches on the path from its leaf to the root against the losers stored there: one comparison per level,
+about log2(k) per element, where a binary heap compares both children on the way down and sifts the next head up again.
+An exhausted run loses every match, as if its head was larger than everything.
+Equal elements come out in the order of their runs, the merge is stable.
+*/
+template<typename T, typename Compare = less<T>>
+class LoserTree {
+public:
+	LoserTree(const vector<pair<const T*, const T*>>& runs, Compare compare = Compare())
+		:runs_(runs), losers_(runs.empty() ? 1 : runs.size()), compare_{ compare }
+	{
+		if (runs_.empty()) {
+			losers_[0] = { nullptr, 0 };
+			return;
+		}
+		//leaf i is node k + i, node n has the children 2n and 2n + 1, the winners are played up from the leaves
+		size_t k = runs_.size();
+		vector<Player> winners(2 * k);
+		for (size_t i = 0; i < k; ++i) {
+			winners[k + i] = { head(i), i };
+		}
+		for (size_t node = k - 1; node > 0; --node) {
+			const Player& left = winners[2 * node];
+			const Player& right = winners[2 * node + 1];
+			if (beats(left, right)) {
+				winners[node] = left;
+				losers_[node] = right;
+			}
+			else {
+				winners[node] = right;
+				losers_[node] = left;
+			}
+		}
+		//for a single run node 1 is its leaf
+		losers_[0] = winners[1];
+	}
+
+	bool empty() const {
+		return losers_[0].head == nullptr;
+	}
+	//the smallest head, the tree must not be empty
+	const T& top() const {
+		return *losers_[0].head;
+	}
+	//run the smallest head is from
+	size_t topRun() const {
+		return losers_[0].run;
+	}
+	//removes the smallest head, the tree must not be empty
+	void pop() {
+		size_t run = losers_[0].run;
+		pop(runs_[run].first + 1, runs_[run].second);
+	}
+	/*
+	Removes the smallest head and continues its run with [first, last) instead of the rest of its range,
+	for runs which arrive in blocks: called with the next block once the head was the last element of the current one.
+	An empty range ends the run
+	*/
+	void pop(const T* first, const T* last) {
+		Player winner = losers_[0];
+		runs_[winner.run] = { first, last };
+		winner.head = head(winner.run);
+		for (size_t node = (winner.run + runs_.size()) / 2; node > 0; node /= 2) {
+			if (beats(losers_[node], winner)) {
+				swap(losers_[node], winner);
+			}
+		}
+		losers_[0] = winner;
+	}
+private:
+	//a run as it plays in the tree, the head is copied next to the index so a match doesn't look up the runs
+	struct Player {
+		//nullptr once the run is exhausted
+		const T* head;
+		size_t run;
+	};
+	vector<pair<const T*, const T*>> runs_;
+	//losers_[0] is the winner
+	vector<Player> losers_;
+	Compare compare_;
+
+	const T* head(size_t run) const {
+		return runs_[run].first == runs_[run].second ? nullptr : runs_[run].first;
+	}
+	//whether a comes out before b, a single comparison of elements
+	bool beats(const Player& a, const Player& b) const {
+		if (a.head == nullptr) {
+			return false;
+		}
+		if (b.head == nullptr) {
+			return true;
+		}
+		//on equal heads the run with the lower index wins
+		return a.run < b.run ? !compare_(*b.head, *a.head) : compare_(*a.head, *b.head);
+	}
+};
+
+//Merges the runs into out, which has room for count elements, count has to be at most their total size
+template<typename T, typename Compare>
+void MergeRuns(const vector<pair<const T*, const T*>>& runs, T* out, size_t count, Compare compare) {
+	LoserTree<T, Compare> tree(runs, compare);
+	for (size_t i = 0; i < count; ++i) {
+		out[i] = tree.top();
+		tree.pop();
+	}
+}
+
+/*
+Merges the sorted arrays into one sorted array with a LoserTree
+The output is allocated once at its final size before merging. Stable: equal elements keep the order of their arrays.
+*/
+template<typename T, typename Compare = less<T>>
+vector<T> MergeKSorted(const vector<vector<T>>& sorted_arrays, Compare compare = Compare()) {
+	size_t total = 0;
+	vector<pair<const T*, const T*>> runs;
+	runs.reserve(sorted_arrays.size());
+	for (const vector<T>& sorted_arr : sorted_arrays) {
+		total += sorted_arr.size();
+		runs.emplace_back(sorted_arr.data(), sorted_arr.data() + sorted_arr.size());
+	}
+	vector<T> result;
+	result.reserve(total);
+	LoserTree<T, Compare> tree(runs, compare);
+	for (size_t i = 0; i < total; ++i) {
+		result.push_back(tree.top());
+		tree.pop();
+	}
+	return result;
+}
+
+/*
+Co-ranking: how many elements of every run are among the first rank elements of their stable merge
+(equal elements ordered by run), rank has to be at most the total size of the runs.
+Every run has a window its split is known to be in, the middle element of the widest window is the pivot.
+Binary searches count the elements before the pivot in each run, their sum is the pivot's rank in the merge:
+if it is rank these counts are the splits, otherwise they bound the splits from one side and the windows shrink to them.
+The widest window at least halves every step, on typical data all of them do, about log2(n) steps of k binary searches.
+*/
+template<typename T, typename Compare = less<T>>
+vector<size_t> CoRank(const vector<pair<const T*, const T*>>& runs, size_t rank, Compare compare = Compare()) {
+	size_t k = runs.size();
+	vector<size_t> low(k, 0);
+	vector<size_t> high(k);
+	for (size_t i = 0; i < k; ++i) {
+		high[i] = runs[i].second - runs[i].first;
+	}
+	vector<size_t> before(k);
+	if (k == 0) {
+		return before;
+	}
+	while (true) {
+		size_t widest = 0;
+		for (size_t i = 1; i < k; ++i) {
+			if (high[i] - low[i] > high[widest] - low[widest]) {
+				widest = i;
+			}
+		}
+		if (high[widest] == low[widest]) {
+			return low;
+		}
+		size_t middle = low[widest] + (high[widest] - low[widest]) / 2;
+		const T& pivot = runs[widest].first[middle];
+		size_t pivotRank = 0;
+		for (size_t i = 0; i < k; ++i) {
+			const T* first = runs[i].first;
+			const T* last = runs[i].second;
+			//runs before the pivot's one put their elements equal to it before it, the runs after it don't
+			if (i < widest) {
+				before[i] = upper_bound(first, last, pivot, compare) - first;
+			}
+			else if (i > widest) {
+				before[i] = lower_bound(first, last, pivot, compare) - first;
+			}
+			else {
+				before[i] = middle;
+			}
+			pivotRank += before[i];
+		}
+		if (pivotRank == rank) {
+			return before;
+		}
+		for (size_t i = 0; i < k; ++i) {
+			if (pivotRank < rank) {
+				//the pivot and everything before it are among the first rank elements
+				low[i] = max(low[i], before[i] + (i == widest ? 1 : 0));
+			}
+			else {
+				high[i] = min(high[i], before[i]);
+			}
+		}
+	}
+}
+
+/*
+Merges the sorted arrays into one sorted array on the threads of the pool, the result is the same as MergeKSorted's
+The output is split into one equal range per worker, CoRank finds the part of every array which goes into each range
+and every range is merged by its own LoserTree straight into the preallocated output (T has to be default constructible).
+Below parallelMergeGrain elements per range the merge isn't worth splitting and fewer ranges are used.
+*/
+constexpr size_t parallelMergeGrain = size_t(1) << 16;
+
+template<typename T, typename Compare = less<T>>
+vector<T> ParallelMergeKSorted(const vector<vector<T>>& sorted_arrays, Compare compare = Compare(),
+	WorkStealingPool& pool = WorkStealingPool::shared()) {
+	size_t total = 0;
+	vector<pair<const T*, const T*>> runs;
+	runs.reserve(sorted_arrays.size());
+	for (const vector<T>& sorted_arr : sorted_arrays) {
+		total += sorted_arr.size();
+		runs.emplace_back(sorted_arr.data(), sorted_arr.data() + sorted_arr.size());
+	}
+	vector<T> result(total);
+	size_t ranges = max<size_t>(1, min(pool.size(), total / parallelMergeGrain));
+	if (ranges == 1) {
+		MergeRuns(runs, result.data(), total, compare);
+		return result;
+	}
+	TaskGroup group(pool);
+	for (size_t range = 0; range < ranges; ++range) {
+		group.run([&runs, &result, &compare, total, ranges, range] {
+			size_t begin = total / ranges * range;
+			size_t end = range + 1 == ranges ? total : total / ranges * (range + 1);
+			vector<size_t> from = CoRank(runs, begin, compare);
+			vector<size_t> to = CoRank(runs, end, compare);
+			vector<pair<const T*, const T*>> parts;
+			parts.reserve(runs.size());
+			for (size_t i = 0; i < runs.size(); ++i) {
+				parts.emplace_back(runs[i].first + from[i], runs[i].first + to[i]);
+			}
+			MergeRuns(parts, result.data() + begin, end - begin, compare);
+		});
+	}
+	group.wait();
+	return result;
+}
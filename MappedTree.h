@@ -0,0 +1,278 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include "FrozenTree.h"
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace CustomBinaryTree {
+	/*
+	File layout (native byte order), every offset is from the start of the file so the file can be mapped anywhere
+		MappedTreeHeader
+		keys    : count + 1 keys in Eytzinger order starting at keysOffset_ (64 byte aligned), the first one is unused
+		entries : count + 1 key-value pairs in the same order starting at entriesOffset_ (64 byte aligned)
+	checksum_ is the FNV-1a hash of everything after the header
+	*/
+	struct MappedTreeHeader {
+		char magic_[8];
+		uint32_t version_;
+		uint32_t keySize_;
+		uint32_t entrySize_;
+		uint32_t entryAlignment_;
+		uint64_t count_;
+		uint64_t keysOffset_;
+		uint64_t entriesOffset_;
+		uint64_t fileSize_;
+		uint64_t checksum_;
+	};
+
+	/*
+	Read only BinaryTree served straight from a memory mapped file, for keys and values which are trivially copyable
+	Save a tree once with MappedTree::save(tree.freeze(), path), opening the file later is a single mmap:
+	find, lower_bound and iteration work on the mapped pages (it is a FrozenTree over them), nothing is allocated
+	per element and pages are only read from disk when a lookup touches them.
+	The file is only usable by builds with the same key and value types (sizes are checked) and byte order.
+	*/
+	template<typename KeyType, typename ValueType>
+	class MappedTree {
+	public:
+		static_assert(std::is_trivially_copyable<KeyType>::value && std::is_trivially_copyable<ValueType>::value,
+			"MappedTree needs trivially copyable keys and values");
+		using value_type = std::pair<KeyType, ValueType>;
+		using const_iterator = typename FrozenTree<KeyType, ValueType>::const_iterator;
+
+		static constexpr uint32_t formatVersion = 1;
+
+		/*
+		Writes the frozen tree to the file at path, replacing it
+		Throws if the file can't be written
+		*/
+		static void save(const FrozenTree<KeyType, ValueType>& tree, const std::string& path) {
+			MappedTreeHeader header = {};
+			std::memcpy(header.magic_, magic, sizeof(header.magic_));
+			header.version_ = formatVersion;
+			header.keySize_ = sizeof(KeyType);
+			header.entrySize_ = sizeof(value_type);
+			header.entryAlignment_ = alignof(value_type);
+			header.count_ = tree.size();
+			header.keysOffset_ = alignUp(sizeof(MappedTreeHeader));
+			header.entriesOffset_ = alignUp(header.keysOffset_ + (tree.size() + 1) * sizeof(KeyType));
+			header.fileSize_ = header.entriesOffset_ + (tree.size() + 1) * sizeof(value_type);
+
+			std::ofstream file(path, std::ios::binary | std::ios::trunc);
+			if (!file) {
+				throw("Cannot open the file for writing");
+			}
+			//header goes last, once the checksum is known
+			uint64_t checksum = checksumSeed;
+			writePadding(file, header.keysOffset_, 0, checksum, false);
+			write(file, tree.keys_, (tree.size() + 1) * sizeof(KeyType), checksum);
+			writePadding(file, header.entriesOffset_, header.keysOffset_ + (tree.size() + 1) * sizeof(KeyType), checksum, true);
+			write(file, tree.entries_, (tree.size() + 1) * sizeof(value_type), checksum);
+			header.checksum_ = checksum;
+			file.seekp(0);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			if (!file.flush()) {
+				throw("Cannot write the file");
+			}
+		}
+
+		/*
+		Maps the file at path read only
+		verifyChecksum reads the whole file once to check it, skip it to only touch the pages lookups need
+		Throws if the file can't be mapped or isn't a valid file for these key and value types
+		*/
+		explicit MappedTree(const std::string& path, bool verifyChecksum = true) {
+			map(path);
+			if (size_ < sizeof(MappedTreeHeader)) {
+				unmap();
+				throw("File too small for a MappedTree");
+			}
+			const MappedTreeHeader& header = *reinterpret_cast<const MappedTreeHeader*>(data_);
+			if (!valid(header, size_)) {
+				unmap();
+				throw("Not a MappedTree file for these key and value types");
+			}
+			if (verifyChecksum) {
+				uint64_t checksum = checksumSeed;
+				hash(data_ + header.keysOffset_, size_ - header.keysOffset_, checksum);
+				if (checksum != header.checksum_) {
+					unmap();
+					throw("MappedTree file is corrupted");
+				}
+			}
+			tree_ = FrozenTree<KeyType, ValueType>(reinterpret_cast<const KeyType*>(data_ + header.keysOffset_),
+				reinterpret_cast<const value_type*>(data_ + header.entriesOffset_), header.count_);
+		}
+		//owns the mapping, neither copied nor moved
+		MappedTree(const MappedTree& other) = delete;
+		MappedTree& operator=(const MappedTree& other) = delete;
+		~MappedTree() {
+			unmap();
+		}
+
+		size_t size() const {
+			return tree_.size();
+		}
+		bool empty() const {
+			return tree_.empty();
+		}
+		const_iterator find(const KeyType& key) const {
+			return tree_.find(key);
+		}
+		const_iterator lower_bound(const KeyType& key) const {
+			return tree_.lower_bound(key);
+		}
+		//iteration using begin and end does an inorder traversal
+		const_iterator begin() const {
+			return tree_.begin();
+		}
+		const_iterator end() const {
+			return tree_.end();
+		}
+		const_iterator cbegin() const {
+			return tree_.cbegin();
+		}
+		const_iterator cend() const {
+			return tree_.cend();
+		}
+	private:
+		static constexpr char magic[8] = { 'B', 'T', 'R', 'E', 'E', 'M', 'A', 'P' };
+		static constexpr uint64_t checksumSeed = 14695981039346656037ull;
+		static constexpr uint64_t alignment = 64;
+
+		FrozenTree<KeyType, ValueType> tree_;
+		const unsigned char* data_ = nullptr;
+		size_t size_ = 0;
+#if defined(_WIN32)
+		HANDLE file_ = INVALID_HANDLE_VALUE;
+		HANDLE mapping_ = nullptr;
+#endif
+
+		/*
+		Whether the header describes a file of this size for these key and value types, as save writes them:
+		the keys after the header and the entries after the keys, both on 64 byte boundaries so the mapped
+		keys and entries are aligned. The offsets are bounded by the file size before any arithmetic on them.
+		*/
+		static bool valid(const MappedTreeHeader& header, size_t fileSize) {
+			if (std::memcmp(header.magic_, magic, sizeof(header.magic_)) != 0 || header.version_ != formatVersion ||
+				header.keySize_ != sizeof(KeyType) || header.entrySize_ != sizeof(value_type) ||
+				header.entryAlignment_ != alignof(value_type) || header.fileSize_ != fileSize || header.count_ >= fileSize) {
+				return false;
+			}
+			if (header.keysOffset_ < sizeof(MappedTreeHeader) || header.keysOffset_ > fileSize || header.keysOffset_ % alignment != 0 ||
+				header.entriesOffset_ > fileSize || header.entriesOffset_ % alignment != 0) {
+				return false;
+			}
+			return header.keysOffset_ + (header.count_ + 1) * sizeof(KeyType) <= header.entriesOffset_ &&
+				header.entriesOffset_ + (header.count_ + 1) * sizeof(value_type) <= fileSize;
+		}
+		static uint64_t alignUp(uint64_t offset) {
+			return (offset + alignment - 1) / alignment * alignment;
+		}
+		//FNV-1a
+		static void hash(const unsigned char* data, size_t length, uint64_t& checksum) {
+			for (size_t i = 0; i < length; ++i) {
+				checksum = (checksum ^ data[i]) * 1099511628211ull;
+			}
+		}
+		static void write(std::ofstream& file, const void* data, size_t length, uint64_t& checksum) {
+			hash(static_cast<const unsigned char*>(data), length, checksum);
+			file.write(static_cast<const char*>(data), length);
+		}
+		//zeroes from position up to offset, hashed only after the header
+		static void writePadding(std::ofstream& file, uint64_t offset, uint64_t position, uint64_t& checksum, bool hashed) {
+			const unsigned char zeroes[alignment] = {};
+			size_t length = static_cast<size_t>(offset - position);
+			if (hashed) {
+				hash(zeroes, length, checksum);
+			}
+			file.write(reinterpret_cast<const char*>(zeroes), length);
+		}
+
+#if defined(_WIN32)
+		void map(const std::string& path) {
+			file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file_ == INVALID_HANDLE_VALUE) {
+				throw("Cannot open the file");
+			}
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file_, &fileSize)) {
+				unmap();
+				throw("Cannot read the size of the file");
+			}
+			size_ = static_cast<size_t>(fileSize.QuadPart);
+			if (size_ == 0) {
+				return;
+			}
+			mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping_ == nullptr) {
+				unmap();
+				throw("Cannot map the file");
+			}
+			data_ = static_cast<const unsigned char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+			if (data_ == nullptr) {
+				unmap();
+				throw("Cannot map the file");
+			}
+		}
+		void unmap() {
+			if (data_ != nullptr) {
+				UnmapViewOfFile(data_);
+			}
+			if (mapping_ != nullptr) {
+				CloseHandle(mapping_);
+			}
+			if (file_ != INVALID_HANDLE_VALUE) {
+				CloseHandle(file_);
+			}
+			data_ = nullptr;
+			mapping_ = nullptr;
+			file_ = INVALID_HANDLE_VALUE;
+		}
+#else
+		void map(const std::string& path) {
+			int fd = open(path.c_str(), O_RDONLY);
+			if (fd < 0) {
+				throw("Cannot open the file");
+			}
+			struct stat status;
+			if (fstat(fd, &status) != 0) {
+				close(fd);
+				throw("Cannot read the size of the file");
+			}
+			size_ = static_cast<size_t>(status.st_size);
+			if (size_ == 0) {
+				close(fd);
+				return;
+			}
+			void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+			//the mapping keeps the file alive
+			close(fd);
+			if (data == MAP_FAILED) {
+				throw("Cannot map the file");
+			}
+			data_ = static_cast<const unsigned char*>(data);
+		}
+		void unmap() {
+			if (data_ != nullptr) {
+				munmap(const_cast<unsigned char*>(data_), size_);
+			}
+			data_ = nullptr;
+		}
+#endif
+	};
+}
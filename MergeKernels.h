@@ -0,0 +1,370 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MERGE_KERNELS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define MERGE_TARGET(isa)
+#else
+//compiles a single function for the instruction set, the processor is checked at run time before it is called
+#define MERGE_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+using namespace std;
+
+/*
+Two way merges of sorted runs of int32_t or int64_t keys
+The vector kernels merge a block of keys of each run at a time with a bitonic merge network: the second block
+is reversed so the two form a bitonic sequence, one min/max of the two vectors splits it into the lower and upper half
+and log2(lanes) more min/max steps sort each half. The lower half is written out, the upper half is merged
+with the next block of the run whose next key is smaller. No comparison of keys decides a branch.
+	AVX2    8 int32_t or 4 int64_t keys per block
+	SSE     4 int32_t keys per block (SSE4.1), int64_t keys use the scalar kernel, 2 lanes don't pay off
+	Scalar  one key at a time
+The widest kernel the processor supports is picked at run time, the program doesn't need to be built for AVX2.
+*/
+enum class MergeKernel { Scalar, SSE, AVX2 };
+
+//Widest kernel this processor supports, detected once
+inline MergeKernel SupportedMergeKernel() {
+	static const MergeKernel kernel = [] {
+#if defined(MERGE_KERNELS_X86)
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		int leaves = info[0];
+		__cpuid(info, 1);
+		bool sse41 = (info[2] & (1 << 19)) != 0;
+		//AVX registers have to be enabled by the operating system too
+		bool avxState = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+		bool avx2 = false;
+		if (leaves >= 7 && avxState) {
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+		}
+#else
+		__builtin_cpu_init();
+		bool sse41 = __builtin_cpu_supports("sse4.1");
+		bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+		return avx2 ? MergeKernel::AVX2 : sse41 ? MergeKernel::SSE : MergeKernel::Scalar;
+#else
+		return MergeKernel::Scalar;
+#endif
+	}();
+	return kernel;
+}
+
+//Merges sorted a and b into out one key at a time, selecting instead of branching on the comparison
+template<typename Key>
+void MergeSortedScalar(const Key* a, size_t aCount, const Key* b, size_t bCount, Key* out) {
+	const Key* aEnd = a + aCount;
+	const Key* bEnd = b + bCount;
+	while (a != aEnd && b != bEnd) {
+		bool fromB = *b < *a;
+		*out++ = fromB ? *b : *a;
+		b += fromB;
+		a += !fromB;
+	}
+	out = copy(a, aEnd, out);
+	copy(b, bEnd, out);
+}
+
+#if defined(MERGE_KERNELS_X86)
+//the last count keys of a run, fewer than a block, filled up with the largest key which sorts after them
+template<typename Key>
+void PadBlock(const Key* keys, size_t count, Key* block, size_t lanes) {
+	copy(keys, keys + count, block);
+	fill(block + count, block + lanes, numeric_limits<Key>::max());
+}
+
+/*
+Operations of a kernel on vectors of keys
+	load, store         unaligned
+	merge(low, high)    both sorted, afterwards low has the lower half of their keys and high the upper half, both sorted
+*/
+struct AVX2Keys32 {
+	typedef int32_t key;
+	typedef __m256i vector_type;
+	static constexpr size_t lanes = 8;
+
+	MERGE_TARGET("avx2") static vector_type load(const key* keys) {
+		return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys));
+	}
+	MERGE_TARGET("avx2") static void store(key* keys, vector_type v) {
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(keys), v);
+	}
+	MERGE_TARGET("avx2") static void merge(vector_type& low, vector_type& high) {
+		vector_type reversed = _mm256_permutevar8x32_epi32(high, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+		vector_type lower = _mm256_min_epi32(low, reversed);
+		vector_type upper = _mm256_max_epi32(low, reversed);
+		low = sortBitonic(lower);
+		high = sortBitonic(upper);
+	}
+private:
+	//compare and swap lanes 4, 2 and 1 apart
+	MERGE_TARGET("avx2") static vector_type sortBitonic(vector_type v) {
+		vector_type partner = _mm256_permute2x128_si256(v, v, 1);
+		v = _mm256_blend_epi32(_mm256_min_epi32(v, partner), _mm256_max_epi32(v, partner), 0xF0);
+		partner = _mm256_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+		v = _mm256_blend_epi32(_mm256_min_epi32(v, partner), _mm256_max_epi32(v, partner), 0xCC);
+		partner = _mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+		return _mm256_blend_epi32(_mm256_min_epi32(v, partner), _mm256_max_epi32(v, partner), 0xAA);
+	}
+};
+
+struct AVX2Keys64 {
+	typedef int64_t key;
+	typedef __m256i vector_type;
+	static constexpr size_t lanes = 4;
+
+	MERGE_TARGET("avx2") static vector_type load(const key* keys) {
+		return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys));
+	}
+	MERGE_TARGET("avx2") static void store(key* keys, vector_type v) {
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(keys), v);
+	}
+	MERGE_TARGET("avx2") static void merge(vector_type& low, vector_type& high) {
+		vector_type reversed = _mm256_permute4x64_epi64(high, _MM_SHUFFLE(0, 1, 2, 3));
+		vector_type lower, upper;
+		minMax(low, reversed, lower, upper);
+		low = sortBitonic(lower);
+		high = sortBitonic(upper);
+	}
+private:
+	//there is no 64 bit min or max before AVX-512, a compare selects the lanes
+	MERGE_TARGET("avx2") static void minMax(vector_type a, vector_type b, vector_type& lower, vector_type& upper) {
+		vector_type greater = _mm256_cmpgt_epi64(a, b);
+		lower = _mm256_blendv_epi8(a, b, greater);
+		upper = _mm256_blendv_epi8(b, a, greater);
+	}
+	//compare and swap lanes 2 and 1 apart
+	MERGE_TARGET("avx2") static vector_type sortBitonic(vector_type v) {
+		vector_type lower, upper;
+		minMax(v, _mm256_permute4x64_epi64(v, _MM_SHUFFLE(1, 0, 3, 2)), lower, upper);
+		v = _mm256_blend_epi32(lower, upper, 0xF0);
+		minMax(v, _mm256_permute4x64_epi64(v, _MM_SHUFFLE(2, 3, 0, 1)), lower, upper);
+		return _mm256_blend_epi32(lower, upper, 0xCC);
+	}
+};
+
+struct SSEKeys32 {
+	typedef int32_t key;
+	typedef __m128i vector_type;
+	static constexpr size_t lanes = 4;
+
+	MERGE_TARGET("sse4.1") static vector_type load(const key* keys) {
+		return _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys));
+	}
+	MERGE_TARGET("sse4.1") static void store(key* keys, vector_type v) {
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(keys), v);
+	}
+	MERGE_TARGET("sse4.1") static void merge(vector_type& low, vector_type& high) {
+		vector_type reversed = _mm_shuffle_epi32(high, _MM_SHUFFLE(0, 1, 2, 3));
+		vector_type lower = _mm_min_epi32(low, reversed);
+		vector_type upper = _mm_max_epi32(low, reversed);
+		low = sortBitonic(lower);
+		high = sortBitonic(upper);
+	}
+private:
+	//compare and swap lanes 2 and 1 apart
+	MERGE_TARGET("sse4.1") static vector_type sortBitonic(vector_type v) {
+		vector_type partner = _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+		v = _mm_blend_epi16(_mm_min_epi32(v, partner), _mm_max_epi32(v, partner), 0xF0);
+		partner = _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+		return _mm_blend_epi16(_mm_min_epi32(v, partner), _mm_max_epi32(v, partner), 0xCC);
+	}
+};
+
+/*
+Block merge loop of the kernels, the same for every instruction set but compiled once per instruction set
+(a function built for AVX2 can't be inlined into one which isn't, so the loop can't be shared)
+The run which runs out first is padded with the largest key, keys equal to the padding are indistinguishable from it
+and only the first aCount + bCount keys are written.
+*/
+template<typename Keys>
+MERGE_TARGET("avx2") void MergeBlocksAVX2(const typename Keys::key* a, size_t aCount, const typename Keys::key* b, size_t bCount,
+	typename Keys::key* out) {
+	typedef typename Keys::key key;
+	constexpr size_t lanes = Keys::lanes;
+	if (aCount < lanes || bCount < lanes) {
+		MergeSortedScalar(a, aCount, b, bCount, out);
+		return;
+	}
+	size_t total = aCount + bCount;
+	key block[lanes];
+	typename Keys::vector_type low = Keys::load(a);
+	typename Keys::vector_type high = Keys::load(b);
+	a += lanes;
+	aCount -= lanes;
+	b += lanes;
+	bCount -= lanes;
+	Keys::merge(low, high);
+	Keys::store(out, low);
+	size_t written = lanes;
+	while (aCount > 0 || bCount > 0) {
+		bool fromA = bCount == 0 || (aCount > 0 && *a < *b);
+		const key*& keys = fromA ? a : b;
+		size_t& count = fromA ? aCount : bCount;
+		if (count >= lanes) {
+			low = Keys::load(keys);
+			keys += lanes;
+			count -= lanes;
+		}
+		else {
+			PadBlock(keys, count, block, lanes);
+			low = Keys::load(block);
+			keys += count;
+			count = 0;
+		}
+		Keys::merge(low, high);
+		if (written + lanes <= total) {
+			Keys::store(out + written, low);
+			written += lanes;
+		}
+		else {
+			Keys::store(block, low);
+			copy(block, block + (total - written), out + written);
+			written = total;
+		}
+	}
+	if (written < total) {
+		Keys::store(block, high);
+		copy(block, block + (total - written), out + written);
+	}
+}
+
+template<typename Keys>
+MERGE_TARGET("sse4.1") void MergeBlocksSSE(const typename Keys::key* a, size_t aCount, const typename Keys::key* b, size_t bCount,
+	typename Keys::key* out) {
+	typedef typename Keys::key key;
+	constexpr size_t lanes = Keys::lanes;
+	if (aCount < lanes || bCount < lanes) {
+		MergeSortedScalar(a, aCount, b, bCount, out);
+		return;
+	}
+	size_t total = aCount + bCount;
+	key block[lanes];
+	typename Keys::vector_type low = Keys::load(a);
+	typename Keys::vector_type high = Keys::load(b);
+	a += lanes;
+	aCount -= lanes;
+	b += lanes;
+	bCount -= lanes;
+	Keys::merge(low, high);
+	Keys::store(out, low);
+	size_t written = lanes;
+	while (aCount > 0 || bCount > 0) {
+		bool fromA = bCount == 0 || (aCount > 0 && *a < *b);
+		const key*& keys = fromA ? a : b;
+		size_t& count = fromA ? aCount : bCount;
+		if (count >= lanes) {
+			low = Keys::load(keys);
+			keys += lanes;
+			count -= lanes;
+		}
+		else {
+			PadBlock(keys, count, block, lanes);
+			low = Keys::load(block);
+			keys += count;
+			count = 0;
+		}
+		Keys::merge(low, high);
+		if (written + lanes <= total) {
+			Keys::store(out + written, low);
+			written += lanes;
+		}
+		else {
+			Keys::store(block, low);
+			copy(block, block + (total - written), out + written);
+			written = total;
+		}
+	}
+	if (written < total) {
+		Keys::store(block, high);
+		copy(block, block + (total - written), out + written);
+	}
+}
+#endif
+
+//Merges sorted a and b into out (room for aCount + bCount keys) with the kernel, which the processor has to support
+inline void MergeSortedKeys(const int32_t* a, size_t aCount, const int32_t* b, size_t bCount, int32_t* out,
+	MergeKernel kernel = SupportedMergeKernel()) {
+#if defined(MERGE_KERNELS_X86)
+	if (kernel == MergeKernel::AVX2) {
+		MergeBlocksAVX2<AVX2Keys32>(a, aCount, b, bCount, out);
+		return;
+	}
+	if (kernel == MergeKernel::SSE) {
+		MergeBlocksSSE<SSEKeys32>(a, aCount, b, bCount, out);
+		return;
+	}
+#endif
+	MergeSortedScalar(a, aCount, b, bCount, out);
+}
+
+inline void MergeSortedKeys(const int64_t* a, size_t aCount, const int64_t* b, size_t bCount, int64_t* out,
+	MergeKernel kernel = SupportedMergeKernel()) {
+#if defined(MERGE_KERNELS_X86)
+	if (kernel == MergeKernel::AVX2) {
+		MergeBlocksAVX2<AVX2Keys64>(a, aCount, b, bCount, out);
+		return;
+	}
+#endif
+	MergeSortedScalar(a, aCount, b, bCount, out);
+}
+
+/*
+Merges the sorted arrays of int32_t or int64_t keys with a tree of two way merges by MergeSortedKeys
+Every round merges the runs pairwise, halving their number, so every key is read and written ceil(log2(k)) times.
+Each of those passes streams through memory with vector merges, for integer keys that beats the LoserTree's
+log2(k) unpredictable comparisons per key even for thousands of runs.
+The rounds alternate between the result and one scratch array of the same size.
+*/
+template<typename Key>
+vector<Key> MergeKSortedKeys(const vector<vector<Key>>& sorted_arrays, MergeKernel kernel = SupportedMergeKernel()) {
+	size_t total = 0;
+	vector<pair<const Key*, const Key*>> runs;
+	for (const vector<Key>& sorted_arr : sorted_arrays) {
+		if (!sorted_arr.empty()) {
+			total += sorted_arr.size();
+			runs.emplace_back(sorted_arr.data(), sorted_arr.data() + sorted_arr.size());
+		}
+	}
+	vector<Key> result(total);
+	if (runs.size() == 1) {
+		copy(runs[0].first, runs[0].second, result.begin());
+	}
+	size_t rounds = 0;
+	for (size_t count = runs.size(); count > 1; count = (count + 1) / 2) {
+		++rounds;
+	}
+	vector<Key> scratch(rounds > 1 ? total : 0);
+	for (size_t round = 0; round < rounds; ++round) {
+		//the last round has to write into result
+		Key* into = (rounds - round) % 2 == 1 ? result.data() : scratch.data();
+		vector<pair<const Key*, const Key*>> merged;
+		for (size_t i = 0; i < runs.size(); i += 2) {
+			size_t size = runs[i].second - runs[i].first;
+			if (i + 1 == runs.size()) {
+				//an odd run out is copied along, a later round may write over the buffer it is in
+				copy(runs[i].first, runs[i].second, into);
+			}
+			else {
+				size_t otherSize = runs[i + 1].second - runs[i + 1].first;
+				MergeSortedKeys(runs[i].first, size, runs[i + 1].first, otherSize, into, kernel);
+				size += otherSize;
+			}
+			merged.emplace_back(into, into + size);
+			into += size;
+		}
+		runs.swap(merged);
+	}
+	return result;
+}
@@ -0,0 +1,217 @@
+#include "stdafx.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+#include "ExternalSort.h"
+#include "LoserTree.h"
+#include "MergeKernels.h"
+
+using namespace std;
+
+/*
+Benchmarks of the k-way merges, build with optimizations
+	Merge_Bench losertree : MergeKSorted against a merge through a priority_queue, 16M ints split into k = 2 to 4096 arrays
+	Merge_Bench external  : ExternalSort of 256 MiB of ints with a few budgets and fan-ins and MergeRunFiles of 16 runs,
+	                        writes its files into the current directory
+	Merge_Bench kernels   : MergeSortedKeys of two runs with every kernel the processor supports,
+	                        then MergeKSortedKeys against MergeKSorted and the priority_queue merge for k = 2 to 512
+*/
+typedef chrono::steady_clock Clock;
+
+double secondsSince(Clock::time_point start) {
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+//the merge MergeKSorted replaced: the head of every array in a binary heap, popped and pushed back for every element
+struct HeadOfSortedArray {
+	bool operator >(const HeadOfSortedArray& that) const {
+		return *current > *that.current;
+	}
+	vector<int>::const_iterator current;
+	vector<int>::const_iterator end;
+};
+
+vector<int> PriorityQueueMerge(const vector<vector<int>>& sorted_arrays) {
+	vector<int> result;
+	priority_queue<HeadOfSortedArray, vector<HeadOfSortedArray>, greater<HeadOfSortedArray>> heads;
+	for (const vector<int>& sorted_arr : sorted_arrays) {
+		if (!sorted_arr.empty()) {
+			heads.push(HeadOfSortedArray{ sorted_arr.cbegin(), sorted_arr.cend() });
+		}
+	}
+	while (!heads.empty()) {
+		HeadOfSortedArray head = heads.top();
+		heads.pop();
+		result.push_back(*head.current);
+		if (++head.current != head.end) {
+			heads.push(head);
+		}
+	}
+	return result;
+}
+
+//k sorted arrays of random ints, total elements in all
+vector<vector<int>> sortedArrays(size_t k, size_t total, mt19937& random) {
+	vector<vector<int>> arrays(k);
+	for (vector<int>& array : arrays) {
+		array.resize(total / k);
+		for (int& element : array) {
+			element = static_cast<int>(random());
+		}
+		sort(array.begin(), array.end());
+	}
+	return arrays;
+}
+
+//best of three runs of the merge, in seconds
+template<typename Merge, typename Result>
+double bestOfThree(Merge merge, Result& result) {
+	double best = 0;
+	for (int run = 0; run < 3; ++run) {
+		Clock::time_point start = Clock::now();
+		result = merge();
+		double seconds = secondsSince(start);
+		best = run == 0 ? seconds : min(best, seconds);
+	}
+	return best;
+}
+
+void benchLoserTree() {
+	const size_t total = size_t(1) << 24;
+	mt19937 random(1);
+	for (size_t k = 2; k <= 4096; k *= 2) {
+		vector<vector<int>> arrays = sortedArrays(k, total, random);
+		vector<int> heap;
+		vector<int> loser;
+		double heapSeconds = bestOfThree([&arrays] { return PriorityQueueMerge(arrays); }, heap);
+		double loserSeconds = bestOfThree([&arrays] { return MergeKSorted(arrays); }, loser);
+		printf("k = %4zu: priority_queue %6.1f Melem/s  LoserTree %6.1f Melem/s  x%.2f%s\n", k, total / heapSeconds / 1e6,
+			total / loserSeconds / 1e6, heapSeconds / loserSeconds, heap == loser ? "" : "  DIFFERENT RESULTS");
+	}
+}
+
+void benchExternal() {
+	const size_t mebibyte = size_t(1) << 20;
+	const size_t count = 256 * mebibyte / sizeof(int);
+	const char* inputPath = "Merge_Bench.input";
+	const char* sortedPath = "Merge_Bench.sorted";
+	mt19937 random(3);
+	{
+		RunFileWriter<int> writer(inputPath);
+		vector<int> block(mebibyte);
+		for (size_t written = 0; written < count; written += block.size()) {
+			for (int& element : block) {
+				element = static_cast<int>(random());
+			}
+			writer(block.data(), block.size());
+		}
+		writer.close();
+	}
+	const size_t configurations[][2] = { { 64, 64 }, { 16, 64 }, { 16, 4 } };
+	for (const size_t* configuration : configurations) {
+		Clock::time_point start = Clock::now();
+		ExternalSort<int>(inputPath, sortedPath, configuration[0] * mebibyte, configuration[1]);
+		double seconds = secondsSince(start);
+		printf("ExternalSort 256 MiB, budget %2zu MiB, fan-in %2zu: %6.2f s  %5.0f MiB/s\n", configuration[0], configuration[1], seconds, 256 / seconds);
+	}
+	remove(inputPath);
+	remove(sortedPath);
+	vector<string> runPaths;
+	for (int run = 0; run < 16; ++run) {
+		vector<int> elements(count / 16);
+		for (int& element : elements) {
+			element = static_cast<int>(random());
+		}
+		sort(elements.begin(), elements.end());
+		runPaths.push_back("Merge_Bench.run" + to_string(run));
+		RunFileWriter<int> writer(runPaths.back());
+		writer(elements.data(), elements.size());
+		writer.close();
+	}
+	Clock::time_point start = Clock::now();
+	{
+		RunFileWriter<int> writer(sortedPath);
+		MergeRunFiles<int>(runPaths, writer, 16 * mebibyte);
+		writer.close();
+	}
+	double seconds = secondsSince(start);
+	printf("MergeRunFiles 16 runs of 16 MiB, budget 16 MiB : %6.2f s  %5.0f MiB/s\n", seconds, 256 / seconds);
+	for (const string& path : runPaths) {
+		remove(path.c_str());
+	}
+	remove(sortedPath);
+}
+
+const char* kernelName(MergeKernel kernel) {
+	return kernel == MergeKernel::AVX2 ? "AVX2  " : kernel == MergeKernel::SSE ? "SSE   " : "Scalar";
+}
+
+//two runs of total / 2 random keys merged by every kernel up to the widest one supported
+template<typename Key>
+void twoWayMerge(const char* keyName, size_t total, mt19937& random) {
+	vector<Key> a(total / 2);
+	vector<Key> b(total / 2);
+	for (size_t i = 0; i < a.size(); ++i) {
+		a[i] = static_cast<Key>(random());
+		b[i] = static_cast<Key>(random());
+	}
+	sort(a.begin(), a.end());
+	sort(b.begin(), b.end());
+	vector<Key> out(total);
+	bool sorted = false;
+	for (MergeKernel kernel : { MergeKernel::Scalar, MergeKernel::SSE, MergeKernel::AVX2 }) {
+		if (kernel > SupportedMergeKernel()) {
+			break;
+		}
+		double seconds = bestOfThree([&] {
+			MergeSortedKeys(a.data(), a.size(), b.data(), b.size(), out.data(), kernel);
+			return is_sorted(out.begin(), out.end());
+		}, sorted);
+		printf("two runs of %s, %s: %7.1f Melem/s%s\n", keyName, kernelName(kernel), total / seconds / 1e6, sorted ? "" : "  NOT SORTED");
+	}
+}
+
+void benchKernels() {
+	const size_t total = size_t(1) << 24;
+	mt19937 random(5);
+	twoWayMerge<int32_t>("int32_t", total, random);
+	twoWayMerge<int64_t>("int64_t", total, random);
+	for (size_t k = 2; k <= 1024; k *= 4) {
+		vector<vector<int>> arrays = sortedArrays(k, total, random);
+		vector<int> heap;
+		vector<int> loser;
+		vector<int> vectorized;
+		vector<int> scalar;
+		double heapSeconds = bestOfThree([&arrays] { return PriorityQueueMerge(arrays); }, heap);
+		double loserSeconds = bestOfThree([&arrays] { return MergeKSorted(arrays); }, loser);
+		double vectorSeconds = bestOfThree([&arrays] { return MergeKSortedKeys(arrays); }, vectorized);
+		double scalarSeconds = bestOfThree([&arrays] { return MergeKSortedKeys(arrays, MergeKernel::Scalar); }, scalar);
+		printf("k = %4zu: priority_queue %6.1f  LoserTree %6.1f  MergeKSortedKeys %s %6.1f  Scalar %6.1f Melem/s%s\n", k,
+			total / heapSeconds / 1e6, total / loserSeconds / 1e6, kernelName(SupportedMergeKernel()), total / vectorSeconds / 1e6,
+			total / scalarSeconds / 1e6, heap == loser && loser == vectorized && vectorized == scalar ? "" : "  DIFFERENT RESULTS");
+	}
+}
+
+int main(int argc, char* argv[]) {
+	const char* benchmark = argc > 1 ? argv[1] : "";
+	if (strcmp(benchmark, "losertree") == 0) {
+		benchLoserTree();
+	}
+	else if (strcmp(benchmark, "external") == 0) {
+		benchExternal();
+	}
+	else if (strcmp(benchmark, "kernels") == 0) {
+		benchKernels();
+	}
+	else {
+		fprintf(stderr, "usage: %s losertree|external|kernels\n", argv[0]);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,111 @@
+#include "stdafx.h"
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <utility>
+#include <vector>
+#include "LoserTree.h"
+
+using namespace std;
+
+/*
+Checks of the k-way merges, exits with 1 on the first failure
+	Merge_Test
+*/
+bool check(bool condition, const char* what) {
+	if (!condition) {
+		fprintf(stderr, "FAILED: %s\n", what);
+	}
+	return condition;
+}
+
+//elements tagged with the index of their array, to see the order of equal elements
+typedef pair<int, int> Tagged;
+
+bool lessKey(const Tagged& a, const Tagged& b) {
+	return a.first < b.first;
+}
+
+vector<vector<Tagged>> tagged(const vector<vector<int>>& arrays) {
+	vector<vector<Tagged>> result(arrays.size());
+	for (size_t i = 0; i < arrays.size(); ++i) {
+		for (int element : arrays[i]) {
+			result[i].emplace_back(element, static_cast<int>(i));
+		}
+	}
+	return result;
+}
+
+//the splits CoRank returns for every rank add up to it, and the prefixes they cut merge into the prefix of the full stable merge
+bool coRank() {
+	mt19937 random(2);
+	for (int round = 0; round < 1000; ++round) {
+		vector<vector<int>> arrays(random() % 12);
+		size_t total = 0;
+		int range = 1 + random() % 50;
+		for (vector<int>& array : arrays) {
+			array.resize(random() % 40);
+			for (int& element : array) {
+				element = random() % range;
+			}
+			sort(array.begin(), array.end());
+			total += array.size();
+		}
+		vector<vector<Tagged>> full = tagged(arrays);
+		vector<Tagged> merged = MergeKSorted(full, lessKey);
+		vector<pair<const int*, const int*>> runs;
+		for (const vector<int>& array : arrays) {
+			runs.emplace_back(array.data(), array.data() + array.size());
+		}
+		for (size_t rank = 0; rank <= total; ++rank) {
+			vector<size_t> splits = CoRank(runs, rank, less<int>());
+			size_t sum = 0;
+			vector<vector<Tagged>> prefixes(arrays.size());
+			for (size_t i = 0; i < arrays.size(); ++i) {
+				sum += splits[i];
+				prefixes[i].assign(full[i].begin(), full[i].begin() + splits[i]);
+			}
+			if (!check(sum == rank, "the splits add up to the rank") ||
+				!check(MergeKSorted(prefixes, lessKey) == vector<Tagged>(merged.begin(), merged.begin() + rank), "the splits cut the prefix of the merge")) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+//ParallelMergeKSorted gives the same result as the serial MergeKSorted, also on equal elements and with ranges split by CoRank
+bool parallelMerge() {
+	mt19937 random(3);
+	WorkStealingPool pool(4);
+	for (int round = 0; round < 30; ++round) {
+		vector<vector<int>> arrays(1 + random() % 300);
+		for (vector<int>& array : arrays) {
+			array.resize(random() % 3000);
+			for (int& element : array) {
+				element = random() % 1000;
+			}
+			sort(array.begin(), array.end());
+		}
+		if (!check(ParallelMergeKSorted(arrays, less<int>(), pool) == MergeKSorted(arrays), "parallel merge of random arrays")) {
+			return false;
+		}
+	}
+	//a million elements in runs of 100 equal ones, every worker gets a range and equal elements have to keep the order of their arrays
+	vector<vector<Tagged>> runs(50);
+	for (int i = 0; i < 50; ++i) {
+		for (int j = 0; j < 20000; ++j) {
+			runs[i].emplace_back(j / 100, i);
+		}
+	}
+	return check(ParallelMergeKSorted(runs, lessKey, pool) == MergeKSorted(runs, lessKey), "parallel merge is stable") &&
+		check(ParallelMergeKSorted(vector<vector<int>>()).empty(), "parallel merge of no arrays");
+}
+
+int main() {
+	if (!coRank() || !parallelMerge()) {
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
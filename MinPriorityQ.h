@@ -1,6 +1,18 @@
 #pragma once
 #include <vector>
 #include <map>
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <utility>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 using namespace std;
 template<typename KeyType, typename compare = less<KeyType>>
 class minPriorityQ {
@@ -121,3 +133,494 @@ private:
 		}
 	}
 };
+
+/*
+Min priority queue of items identified by ids (like the vertices of a graph), each with a key
+A position map from id to heap slot follows every move in the heap, so the key of an item can be decreased
+and an item erased by its id, each in O(log n). Every item is in the heap once, unlike with lazy reinsertion.
+The position map grows to the largest id pushed, ids should be dense (0 to n - 1).
+*/
+template<typename KeyType, typename compare = less<KeyType>>
+class indexedMinPriorityQ {
+public:
+	explicit indexedMinPriorityQ(size_t idCount = 0) :_position(idCount, npos)
+	{}
+
+	/*
+	Adds the item with the key
+	Throws if the id is in the queue already
+	*/
+	void push(size_t id, KeyType key) {
+		if (contains(id)) {
+			throw("Id is in the queue already");
+		}
+		if (id >= _position.size()) {
+			_position.resize(id + 1, npos);
+		}
+		_heap.push_back(Entry{ move(key), id });
+		_position[id] = _heap.size() - 1;
+		swim_up(_heap.size() - 1);
+	}
+	/*
+	Changes the key of the item to a lesser one and restores the min priority queue invariant
+	Throws if the id isn't in the queue or the key is not lesser
+	*/
+	void decrease_key(size_t id, KeyType key) {
+		if (!contains(id)) {
+			throw("Id is not in the queue");
+		}
+		size_t slot = _position[id];
+		if (!_less(key, _heap[slot].key)) {
+			throw("New key is not lesser than earlier");
+		}
+		_heap[slot].key = move(key);
+		swim_up(slot);
+	}
+	bool contains(size_t id) const {
+		return id < _position.size() && _position[id] != npos;
+	}
+	//Throws if the id isn't in the queue
+	const KeyType& key(size_t id) const {
+		if (!contains(id)) {
+			throw("Id is not in the queue");
+		}
+		return _heap[_position[id]].key;
+	}
+	//Removes the item, throws if the id isn't in the queue
+	void erase(size_t id) {
+		if (!contains(id)) {
+			throw("Id is not in the queue");
+		}
+		removeAt(_position[id]);
+	}
+
+	const KeyType& min() const {
+		if (_heap.empty()) {
+			throw("Underflow error");
+		}
+		return _heap.front().key;
+	}
+	size_t minId() const {
+		if (_heap.empty()) {
+			throw("Underflow error");
+		}
+		return _heap.front().id;
+	}
+	//Removes the item with the minimum key
+	void extractMin() {
+		if (_heap.empty()) {
+			throw("Underflow error");
+		}
+		removeAt(0);
+	}
+	size_t size() const {
+		return _heap.size();
+	}
+	bool empty() const {
+		return _heap.empty();
+	}
+private:
+	static constexpr size_t npos = ~size_t(0);
+	struct Entry {
+		KeyType key;
+		size_t id;
+	};
+	//0 based, the children of slot i are 2i + 1 and 2i + 2
+	vector<Entry> _heap;
+	//slot of every id in _heap, npos if it isn't in the queue
+	vector<size_t> _position;
+	compare _less;
+
+	void place(size_t slot, Entry&& entry) {
+		_position[entry.id] = slot;
+		_heap[slot] = move(entry);
+	}
+	void removeAt(size_t slot) {
+		_position[_heap[slot].id] = npos;
+		Entry last = move(_heap.back());
+		_heap.pop_back();
+		if (slot < _heap.size()) {
+			place(slot, move(last));
+			//the last item may belong above or below the slot
+			sink_down(slot);
+			swim_up(slot);
+		}
+	}
+	/*
+	Moves the parents down until the one of the item at slot is not greater, then puts the item in the hole
+	*/
+	void swim_up(size_t slot) {
+		Entry entry = move(_heap[slot]);
+		while (slot > 0) {
+			size_t parent = (slot - 1) / 2;
+			if (!_less(entry.key, _heap[parent].key)) {
+				break;
+			}
+			place(slot, move(_heap[parent]));
+			slot = parent;
+		}
+		place(slot, move(entry));
+	}
+	/*
+	Moves the lesser child up until neither is lesser than the item at slot, then puts the item in the hole
+	*/
+	void sink_down(size_t slot) {
+		Entry entry = move(_heap[slot]);
+		while (true) {
+			size_t child = 2 * slot + 1;
+			if (child >= _heap.size()) {
+				break;
+			}
+			if (child + 1 < _heap.size() && _less(_heap[child + 1].key, _heap[child].key)) {
+				++child;
+			}
+			if (!_less(_heap[child].key, entry.key)) {
+				break;
+			}
+			place(slot, move(_heap[child]));
+			slot = child;
+		}
+		place(slot, move(entry));
+	}
+};
+
+//Allocates on cache line (64 byte) boundaries, so that heap slots can be laid out by cache line
+template<typename T>
+struct CacheAlignedAllocator {
+	typedef T value_type;
+	static constexpr size_t alignment = 64;
+
+	CacheAlignedAllocator() = default;
+	template<typename U>
+	CacheAlignedAllocator(const CacheAlignedAllocator<U>&)
+	{}
+	T* allocate(size_t count) {
+		return static_cast<T*>(::operator new(count * sizeof(T), align_val_t(alignment)));
+	}
+	void deallocate(T* pointer, size_t) {
+		::operator delete(pointer, align_val_t(alignment));
+	}
+	template<typename U>
+	bool operator==(const CacheAlignedAllocator<U>&) const {
+		return true;
+	}
+	template<typename U>
+	bool operator!=(const CacheAlignedAllocator<U>&) const {
+		return false;
+	}
+};
+
+/*
+Min priority queue in a heap where every node has Arity children
+The children of a node are next to each other, with the heap starting Arity - 1 slots into a cache line aligned array
+they share a cache line when Arity * sizeof(KeyType) is at most 64 (4 or 8 for 8 or 4 byte keys), so each level
+of sink_down is one cache miss at most, and the tree is log2(Arity) times shallower than a binary heap.
+Elements are moved into the hole left by the element being placed instead of being swapped.
+*/
+template<typename KeyType, size_t Arity = 4, typename compare = less<KeyType>>
+class dAryMinPriorityQ {
+public:
+	static_assert(Arity >= 2, "A heap node needs at least two children");
+
+	explicit dAryMinPriorityQ(compare less = compare()) :_heap(offset), _less{ less }
+	{}
+	/*
+	Takes the elements over and arranges them into a heap bottom up (Floyd), O(n) instead of n pushes
+	*/
+	explicit dAryMinPriorityQ(vector<KeyType>&& dataArray, compare less = compare()) :_heap(offset), _less{ less }
+	{
+		_heap.reserve(offset + dataArray.size());
+		move(dataArray.begin(), dataArray.end(), back_inserter(_heap));
+		dataArray.clear();
+		heapify();
+	}
+
+	void push(KeyType key) {
+		_heap.push_back(move(key));
+		swim_up(size() - 1);
+	}
+	/*
+	Pushes all the elements of the range
+	When the range is larger than the heap, the heap is rebuilt bottom up instead, O(n) for the whole heap
+	*/
+	template<typename InputIt>
+	void push_range(InputIt first, InputIt last) {
+		size_t before = size();
+		_heap.insert(_heap.end(), first, last);
+		if (size() - before > before) {
+			heapify();
+		}
+		else {
+			for (size_t slot = before; slot < size(); ++slot) {
+				swim_up(slot);
+			}
+		}
+	}
+	const KeyType& min() const {
+		if (empty()) {
+			throw("Underflow error");
+		}
+		return base()[0];
+	}
+	/*
+	Removes the minimum element, like minPriorityQ it doesn't return it
+	*/
+	void extractMin() {
+		if (empty()) {
+			throw("Underflow error");
+		}
+		removeMin();
+	}
+	/*
+	Moves the count minimum elements to out in ascending order and removes them
+	Throws if there are fewer than count elements, before removing any
+	*/
+	template<typename OutputIt>
+	OutputIt pop_n(size_t count, OutputIt out) {
+		if (count > size()) {
+			throw("Underflow error");
+		}
+		for (size_t i = 0; i < count; ++i) {
+			*out++ = move(base()[0]);
+			removeMin();
+		}
+		return out;
+	}
+	size_t size() const {
+		return _heap.size() - offset;
+	}
+	bool empty() const {
+		return _heap.size() == offset;
+	}
+private:
+	//unused slots before the root, so that the children of every node start a cache line
+	static constexpr size_t offset = Arity - 1;
+	//node i is at base()[i], its children are Arity * i + 1 to Arity * i + Arity
+	vector<KeyType, CacheAlignedAllocator<KeyType>> _heap;
+	compare _less;
+
+	KeyType* base() {
+		return _heap.data() + offset;
+	}
+	const KeyType* base() const {
+		return _heap.data() + offset;
+	}
+	void heapify() {
+		if (size() < 2) {
+			return;
+		}
+		for (size_t slot = (size() - 2) / Arity + 1; slot > 0; --slot) {
+			sink_down(slot - 1);
+		}
+	}
+	void removeMin() {
+		KeyType last = move(_heap.back());
+		_heap.pop_back();
+		if (!empty()) {
+			base()[0] = move(last);
+			sink_down(0);
+		}
+	}
+	/*
+	Takes the element at slot out and moves the least child up into the hole until none is lesser than it
+	*/
+	void sink_down(size_t slot) {
+		KeyType* heap = base();
+		size_t count = size();
+		KeyType key = move(heap[slot]);
+		while (true) {
+			size_t first = Arity * slot + 1;
+			if (first >= count) {
+				break;
+			}
+			size_t least = first;
+			if (first + Arity <= count) {
+				//all the children are there, the loop has a constant trip count
+				for (size_t child = first + 1; child < first + Arity; ++child) {
+					if (_less(heap[child], heap[least])) {
+						least = child;
+					}
+				}
+			}
+			else {
+				for (size_t child = first + 1; child < count; ++child) {
+					if (_less(heap[child], heap[least])) {
+						least = child;
+					}
+				}
+			}
+			if (!_less(heap[least], key)) {
+				break;
+			}
+			heap[slot] = move(heap[least]);
+			slot = least;
+		}
+		heap[slot] = move(key);
+	}
+	/*
+	Takes the element at slot out and moves the parents down into the hole until the parent is not greater
+	*/
+	void swim_up(size_t slot) {
+		KeyType* heap = base();
+		KeyType key = move(heap[slot]);
+		while (slot > 0) {
+			size_t parent = (slot - 1) / Arity;
+			if (!_less(key, heap[parent])) {
+				break;
+			}
+			heap[slot] = move(heap[parent]);
+			slot = parent;
+		}
+		heap[slot] = move(key);
+	}
+};
+
+//Key of a radixMinPriorityQ with its value, or the key alone for ValueType void
+template<typename KeyType, typename ValueType>
+struct radixEntry {
+	KeyType key;
+	ValueType value;
+};
+template<typename KeyType>
+struct radixEntry<KeyType, void> {
+	KeyType key;
+};
+
+/*
+Min priority queue for unsigned integer keys which come out in non-decreasing order (monotone), like the distances
+of Dijkstra with integer weights or the timestamps of an event simulation. A pushed key must not be less than
+the last extracted minimum, debug builds assert it.
+The keys are kept in buckets by the highest bit they differ in from the last minimum: bucket 0 holds the keys equal to it,
+bucket b + 1 the keys which differ in bit b first. When bucket 0 runs empty the first non empty bucket is spread
+over the lower buckets around its own minimum, a key only ever moves to a lower bucket. Only extractMin moves keys:
+min and minValue leave the buckets as they are, a key between the last extracted minimum and the current one can still be pushed.
+push is O(1) and extractMin amortized O(log C) (C the largest difference between a key and the minimum),
+no key is compared with the others log(n) times like in a binary heap.
+The buckets are cleared and never shrunk, their memory is reused by the following passes.
+ValueType is carried along with every key (the vertex for Dijkstra), void for keys alone.
+*/
+template<typename KeyType, typename ValueType = void>
+class radixMinPriorityQ {
+public:
+	static_assert(is_integral<KeyType>::value && is_unsigned<KeyType>::value && !is_same<KeyType, bool>::value,
+		"A radix heap needs unsigned integer keys");
+
+	void push(KeyType key) {
+		static_assert(is_void<ValueType>::value, "The key needs a value");
+		place(Entry{ key });
+	}
+	template<typename Value = ValueType>
+	void push(KeyType key, typename enable_if<!is_void<Value>::value, Value>::type value) {
+		place(Entry{ key, move(value) });
+	}
+	KeyType min() {
+		if (empty()) {
+			throw("Underflow error");
+		}
+		return peek().key;
+	}
+	//value of the minimum key, one of them if there are several
+	template<typename Value = ValueType>
+	const Value& minValue() {
+		if (empty()) {
+			throw("Underflow error");
+		}
+		return peek().value;
+	}
+	void extractMin() {
+		if (empty()) {
+			throw("Underflow error");
+		}
+		refill();
+		_buckets[0].pop_back();
+		--_size;
+	}
+	size_t size() const {
+		return _size;
+	}
+	bool empty() const {
+		return _size == 0;
+	}
+private:
+	typedef radixEntry<KeyType, ValueType> Entry;
+	static constexpr size_t bits = numeric_limits<KeyType>::digits;
+	vector<Entry> _buckets[bits + 1];
+	//last extracted minimum, the buckets are relative to it
+	KeyType _last = 0;
+	size_t _size = 0;
+	//while bucket 0 is empty: whether peek() found the minimum, and its bucket and slot
+	bool _found = false;
+	size_t _minBucket = 0;
+	size_t _minSlot = 0;
+
+	static size_t bucket(KeyType key, KeyType last) {
+		if (key == last) {
+			return 0;
+		}
+		unsigned long long differ = key ^ last;
+#if defined(_MSC_VER)
+		unsigned long highest;
+		_BitScanReverse64(&highest, differ);
+		return highest + 1;
+#else
+		return 64 - __builtin_clzll(differ);
+#endif
+	}
+	void place(Entry&& entry) {
+		assert(entry.key >= _last && "Key less than the last extracted minimum");
+		//a lesser key is the new minimum, the slots of the others stay where they are
+		if (_found && entry.key < _buckets[_minBucket][_minSlot].key) {
+			_found = false;
+		}
+		_buckets[bucket(entry.key, _last)].push_back(move(entry));
+		++_size;
+	}
+	/*
+	Entry with the minimum key, the queue must not be empty
+	Nothing is moved: the buckets stay relative to the last extracted minimum, so keys between it and the minimum
+	can still be pushed after a peek. The minimum of the first non empty bucket is remembered for the next calls
+	*/
+	const Entry& peek() {
+		if (!_buckets[0].empty()) {
+			return _buckets[0].back();
+		}
+		if (!_found) {
+			_minBucket = 1;
+			while (_buckets[_minBucket].empty()) {
+				++_minBucket;
+			}
+			const vector<Entry>& candidates = _buckets[_minBucket];
+			_minSlot = 0;
+			for (size_t slot = 1; slot < candidates.size(); ++slot) {
+				if (candidates[slot].key < candidates[_minSlot].key) {
+					_minSlot = slot;
+				}
+			}
+			_found = true;
+		}
+		return _buckets[_minBucket][_minSlot];
+	}
+	//moves the minimum keys into bucket 0 if it is empty, the queue must not be empty, only extractMin moves the buckets
+	void refill() {
+		if (!_buckets[0].empty()) {
+			return;
+		}
+		_last = peek().key;
+		_found = false;
+		//the peeked entry is spread last so it ends up at the back of bucket 0, minValue and extractMin agree
+		vector<Entry>& spread = _buckets[_minBucket];
+		swap(spread[_minSlot], spread.back());
+		for (Entry& entry : spread) {
+			_buckets[bucket(entry.key, _last)].push_back(move(entry));
+		}
+		spread.clear();
+	}
+};
+
+/*
+Min priority queue for keys extracted in non-decreasing order:
+radixMinPriorityQ for unsigned integer keys, minPriorityQ for any other key
+*/
+template<typename KeyType>
+using monotoneMinPriorityQ = typename conditional<is_integral<KeyType>::value && is_unsigned<KeyType>::value && !is_same<KeyType, bool>::value,
+	radixMinPriorityQ<KeyType>, minPriorityQ<KeyType>>::type;
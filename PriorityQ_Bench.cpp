@@ -0,0 +1,266 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+#include "MinPriorityQ.h"
+
+using namespace std;
+
+/*
+Benchmarks of the priority queues, build with optimizations
+	PriorityQ_Bench dijkstra : Dijkstra on a random graph of 1M vertices and 8M edges with indexedMinPriorityQ and decrease_key
+	                           against lazy reinsertion into minPriorityQ and std::priority_queue
+	PriorityQ_Bench radix    : Dijkstra on random graphs of 1M vertices with radixMinPriorityQ against lazy reinsertion into
+	                           minPriorityQ and dAryMinPriorityQ and against indexedMinPriorityQ, for small and large weights
+	PriorityQ_Bench dary     : push, pop and heapify of 10M random non-negative ints with dAryMinPriorityQ of arity 2, 4 and 8 against minPriorityQ
+*/
+typedef chrono::steady_clock Clock;
+
+double millisecondsSince(Clock::time_point start) {
+	return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+//adjacency arrays: the edges of vertex v are first[v] to first[v + 1] - 1
+struct Graph {
+	vector<uint32_t> first;
+	vector<uint32_t> to;
+	vector<uint32_t> weight;
+	size_t vertices() const {
+		return first.size() - 1;
+	}
+};
+
+//every vertex gets degree edges to random vertices with random weights from 1 to maxWeight
+Graph randomGraph(uint32_t vertices, uint32_t degree, mt19937& random, uint32_t maxWeight = 1000) {
+	Graph graph;
+	graph.first.resize(vertices + 1);
+	for (uint32_t vertex = 0; vertex <= vertices; ++vertex) {
+		graph.first[vertex] = vertex * degree;
+	}
+	graph.to.resize(size_t(vertices) * degree);
+	graph.weight.resize(graph.to.size());
+	for (size_t edge = 0; edge < graph.to.size(); ++edge) {
+		graph.to[edge] = random() % vertices;
+		graph.weight[edge] = 1 + random() % maxWeight;
+	}
+	return graph;
+}
+
+const uint64_t unreachable = ~uint64_t(0);
+
+//distances from vertex 0, every vertex is in the queue once and its key is decreased, peak is the largest queue size
+vector<uint64_t> indexedDijkstra(const Graph& graph, size_t& peak) {
+	vector<uint64_t> distance(graph.vertices(), unreachable);
+	indexedMinPriorityQ<uint64_t> queue(graph.vertices());
+	distance[0] = 0;
+	queue.push(0, 0);
+	peak = 0;
+	while (!queue.empty()) {
+		peak = max(peak, queue.size());
+		size_t vertex = queue.minId();
+		queue.extractMin();
+		for (uint32_t edge = graph.first[vertex]; edge < graph.first[vertex + 1]; ++edge) {
+			uint32_t next = graph.to[edge];
+			uint64_t through = distance[vertex] + graph.weight[edge];
+			if (through < distance[next]) {
+				if (queue.contains(next)) {
+					queue.decrease_key(next, through);
+				}
+				else {
+					queue.push(next, through);
+				}
+				distance[next] = through;
+			}
+		}
+	}
+	return distance;
+}
+
+/*
+Distances from vertex 0, a shorter path pushes the vertex again and the outdated entries are skipped when they come out
+Queue is a min queue of (distance, vertex) pairs, top and pop are the adapters of minPriorityQ and std::priority_queue
+*/
+template<typename Queue, typename Top, typename Pop>
+vector<uint64_t> lazyDijkstra(const Graph& graph, size_t& peak, Queue& queue, Top top, Pop pop) {
+	vector<uint64_t> distance(graph.vertices(), unreachable);
+	distance[0] = 0;
+	queue.push(make_pair(uint64_t(0), uint32_t(0)));
+	peak = 0;
+	size_t size = 1;
+	while (size > 0) {
+		peak = max(peak, size);
+		pair<uint64_t, uint32_t> entry = top(queue);
+		pop(queue);
+		--size;
+		if (entry.first > distance[entry.second]) {
+			continue;
+		}
+		for (uint32_t edge = graph.first[entry.second]; edge < graph.first[entry.second + 1]; ++edge) {
+			uint32_t next = graph.to[edge];
+			uint64_t through = entry.first + graph.weight[edge];
+			if (through < distance[next]) {
+				distance[next] = through;
+				queue.push(make_pair(through, next));
+				++size;
+			}
+		}
+	}
+	return distance;
+}
+
+void benchDijkstra() {
+	mt19937 random(7);
+	Graph graph = randomGraph(1 << 20, 8, random);
+	typedef pair<uint64_t, uint32_t> Entry;
+	size_t peak;
+	Clock::time_point start = Clock::now();
+	vector<uint64_t> indexed = indexedDijkstra(graph, peak);
+	printf("indexedMinPriorityQ, decrease_key  %7.0f ms  peak queue %8zu\n", millisecondsSince(start), peak);
+	start = Clock::now();
+	minPriorityQ<Entry> heap;
+	vector<uint64_t> lazy = lazyDijkstra(graph, peak, heap,
+		[](minPriorityQ<Entry>& queue) { return queue.min(); }, [](minPriorityQ<Entry>& queue) { queue.extractMin(); });
+	printf("minPriorityQ, lazy reinsertion     %7.0f ms  peak queue %8zu%s\n", millisecondsSince(start), peak,
+		lazy == indexed ? "" : "  DIFFERENT DISTANCES");
+	start = Clock::now();
+	priority_queue<Entry, vector<Entry>, greater<Entry>> standard;
+	vector<uint64_t> lazyStandard = lazyDijkstra(graph, peak, standard,
+		[](priority_queue<Entry, vector<Entry>, greater<Entry>>& queue) { return queue.top(); },
+		[](priority_queue<Entry, vector<Entry>, greater<Entry>>& queue) { queue.pop(); });
+	printf("std::priority_queue, lazy          %7.0f ms  peak queue %8zu%s\n", millisecondsSince(start), peak,
+		lazyStandard == indexed ? "" : "  DIFFERENT DISTANCES");
+}
+
+//lazy reinsertion like lazyDijkstra, the vertex is the value of its distance instead of the second half of a pair
+vector<uint64_t> radixDijkstra(const Graph& graph) {
+	vector<uint64_t> distance(graph.vertices(), unreachable);
+	radixMinPriorityQ<uint64_t, uint32_t> queue;
+	distance[0] = 0;
+	queue.push(0, 0);
+	while (!queue.empty()) {
+		uint64_t reached = queue.min();
+		uint32_t vertex = queue.minValue();
+		queue.extractMin();
+		if (reached > distance[vertex]) {
+			continue;
+		}
+		for (uint32_t edge = graph.first[vertex]; edge < graph.first[vertex + 1]; ++edge) {
+			uint32_t next = graph.to[edge];
+			uint64_t through = reached + graph.weight[edge];
+			if (through < distance[next]) {
+				distance[next] = through;
+				queue.push(through, next);
+			}
+		}
+	}
+	return distance;
+}
+
+void benchRadix() {
+	typedef pair<uint64_t, uint32_t> Entry;
+	mt19937 random(7);
+	for (uint32_t maxWeight : { 100u, 1000000u }) {
+		for (uint32_t degree : { 4u, 16u }) {
+			Graph graph = randomGraph(1 << 20, degree, random, maxWeight);
+			size_t peak;
+			Clock::time_point start = Clock::now();
+			vector<uint64_t> radix = radixDijkstra(graph);
+			double radixTime = millisecondsSince(start);
+			start = Clock::now();
+			minPriorityQ<Entry> binary;
+			vector<uint64_t> lazy = lazyDijkstra(graph, peak, binary,
+				[](minPriorityQ<Entry>& queue) { return queue.min(); }, [](minPriorityQ<Entry>& queue) { queue.extractMin(); });
+			double lazyTime = millisecondsSince(start);
+			start = Clock::now();
+			dAryMinPriorityQ<Entry> dAry;
+			vector<uint64_t> lazyDAry = lazyDijkstra(graph, peak, dAry,
+				[](dAryMinPriorityQ<Entry>& queue) { return queue.min(); }, [](dAryMinPriorityQ<Entry>& queue) { queue.extractMin(); });
+			double dAryTime = millisecondsSince(start);
+			start = Clock::now();
+			vector<uint64_t> indexed = indexedDijkstra(graph, peak);
+			double indexedTime = millisecondsSince(start);
+			printf("degree %2u, weights 1 to %7u: radix %5.0f ms  minPriorityQ %5.0f ms  dAryMinPriorityQ<4> %5.0f ms  indexed %5.0f ms%s\n",
+				degree, maxWeight, radixTime, lazyTime, dAryTime, indexedTime,
+				radix == lazy && lazy == lazyDAry && lazyDAry == indexed ? "" : "  DIFFERENT DISTANCES");
+		}
+	}
+}
+
+//pushes the data one by one, pops it all, then builds a heap of it bottom up
+template<size_t Arity>
+void pushPopHeapify(const vector<int>& data) {
+	dAryMinPriorityQ<int, Arity> queue;
+	Clock::time_point start = Clock::now();
+	for (int element : data) {
+		queue.push(element);
+	}
+	double push = millisecondsSince(start);
+	long long sum = 0;
+	start = Clock::now();
+	while (!queue.empty()) {
+		sum += queue.min();
+		queue.extractMin();
+	}
+	double pop = millisecondsSince(start);
+	vector<int> copy(data);
+	start = Clock::now();
+	dAryMinPriorityQ<int, Arity> heapified(move(copy));
+	double heapify = millisecondsSince(start);
+	printf("dAryMinPriorityQ<%zu>: push %6.1f Mops/s  pop %6.1f Mops/s  heapify %6.0f ms  (%lld)\n", Arity,
+		data.size() / push / 1e3, data.size() / pop / 1e3, heapify, sum);
+}
+
+void benchDAry() {
+	mt19937 random(9);
+	vector<int> data(10000000);
+	//not negative: the root of minPriorityQ is compared with the default constructed key in front of it
+	for (int& element : data) {
+		element = static_cast<int>(random() >> 1);
+	}
+	minPriorityQ<int> queue;
+	Clock::time_point start = Clock::now();
+	for (int element : data) {
+		queue.push(element);
+	}
+	double push = millisecondsSince(start);
+	long long sum = 0;
+	start = Clock::now();
+	while (!queue.empty()) {
+		sum += queue.min();
+		queue.extractMin();
+	}
+	double pop = millisecondsSince(start);
+	start = Clock::now();
+	minPriorityQ<int> built(data);
+	double build = millisecondsSince(start);
+	printf("minPriorityQ       : push %6.1f Mops/s  pop %6.1f Mops/s  built by pushes %6.0f ms  (%lld)\n",
+		data.size() / push / 1e3, data.size() / pop / 1e3, build, sum);
+	pushPopHeapify<2>(data);
+	pushPopHeapify<4>(data);
+	pushPopHeapify<8>(data);
+}
+
+int main(int argc, char* argv[]) {
+	const char* benchmark = argc > 1 ? argv[1] : "";
+	if (strcmp(benchmark, "dijkstra") == 0) {
+		benchDijkstra();
+	}
+	else if (strcmp(benchmark, "radix") == 0) {
+		benchRadix();
+	}
+	else if (strcmp(benchmark, "dary") == 0) {
+		benchDAry();
+	}
+	else {
+		fprintf(stderr, "usage: %s dijkstra|radix|dary\n", argv[0]);
+		return 1;
+	}
+	return 0;
+}
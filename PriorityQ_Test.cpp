@@ -0,0 +1,237 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "ConcurrentPriorityQ.h"
+
+using namespace std;
+
+/*
+Checks of the priority queues, exits with 1 on the first failure
+	PriorityQ_Test
+*/
+bool check(bool condition, const char* what) {
+	if (!condition) {
+		fprintf(stderr, "FAILED: %s\n", what);
+	}
+	return condition;
+}
+
+//counts of the keys 0 to n - 1 still in a queue, the sum of the counts of the keys less than a key is its rank error
+class RankCounter {
+public:
+	explicit RankCounter(size_t n) :tree_(n + 1)
+	{}
+	void add(size_t key, int count) {
+		for (++key; key < tree_.size(); key += key & (0 - key)) {
+			tree_[key] += count;
+		}
+	}
+	int less(size_t key) const {
+		int sum = 0;
+		for (; key > 0; key -= key & (0 - key)) {
+			sum += tree_[key];
+		}
+		return sum;
+	}
+private:
+	//Fenwick tree
+	vector<int> tree_;
+};
+
+/*
+Pops all of n shuffled keys from a MultiQueue on one thread, the keys still in the queue which are less than a popped one
+are its rank error. The mean has to stay within the number of heaps and the largest within 16 times that
+*/
+bool multiQueueRanks(size_t threads, size_t queuesPerThread) {
+	const size_t n = 100000;
+	size_t heaps = threads * queuesPerThread;
+	MultiQueue<int> queue(threads, queuesPerThread);
+	vector<int> keys(n);
+	for (size_t i = 0; i < n; ++i) {
+		keys[i] = static_cast<int>(i);
+	}
+	shuffle(keys.begin(), keys.end(), mt19937(1));
+	RankCounter counter(n);
+	for (int key : keys) {
+		queue.push(key);
+		counter.add(key, 1);
+	}
+	double sum = 0;
+	int largest = 0;
+	for (size_t i = 0; i < n; ++i) {
+		int key;
+		if (!check(queue.tryPop(key), "every pushed key is popped")) {
+			return false;
+		}
+		int rank = counter.less(key);
+		counter.add(key, -1);
+		sum += rank;
+		largest = max(largest, rank);
+	}
+	printf("%3zu heaps: mean rank error %6.2f, largest %4d\n", heaps, sum / n, largest);
+	int key;
+	if (!check(!queue.tryPop(key) && queue.empty(), "the queue is empty once every key was popped")) {
+		return false;
+	}
+	//with at most two heaps a pop compares the minimums of both, the order is exact
+	if (heaps <= 2) {
+		return check(largest == 0, "one or two heaps on one thread pop in order");
+	}
+	return check(sum / n <= heaps, "mean rank error within the number of heaps") && check(largest <= 16 * int(heaps), "largest rank error bounded");
+}
+
+//threads push distinct keys and pop concurrently, then the rest is drained: every key has to come out exactly once
+bool multiQueueExactlyOnce(size_t threads) {
+	const size_t perThread = 20000;
+	MultiQueue<int> queue(threads);
+	vector<atomic<int>> popped(threads * perThread);
+	vector<thread> workers;
+	for (size_t t = 0; t < threads; ++t) {
+		workers.emplace_back([&queue, &popped, t] {
+			int key;
+			for (size_t i = 0; i < perThread; ++i) {
+				queue.push(static_cast<int>(t * perThread + i));
+				if (i % 2 == 1 && queue.tryPop(key)) {
+					++popped[key];
+				}
+			}
+		});
+	}
+	for (thread& worker : workers) {
+		worker.join();
+	}
+	int key;
+	while (queue.tryPop(key)) {
+		++popped[key];
+	}
+	bool once = true;
+	for (atomic<int>& count : popped) {
+		once &= count == 1;
+	}
+	return check(once, "every key is popped exactly once") && check(queue.size() == 0, "nothing is left in the queue");
+}
+
+//key whose moves throw while failMoves is set, so that a push throws with the lock of its heap held
+struct FragileKey {
+	static bool failMoves;
+	explicit FragileKey(int key = 0) :key_{ key }
+	{}
+	FragileKey(const FragileKey& that) = default;
+	FragileKey(FragileKey&& that) :key_{ that.key_ } {
+		if (failMoves) {
+			throw runtime_error("move failed");
+		}
+	}
+	FragileKey& operator=(const FragileKey& that) = default;
+	FragileKey& operator=(FragileKey&& that) {
+		if (failMoves) {
+			throw runtime_error("move failed");
+		}
+		key_ = that.key_;
+		return *this;
+	}
+	bool operator <(const FragileKey& that) const {
+		return key_ < that.key_;
+	}
+	int key_;
+};
+bool FragileKey::failMoves = false;
+
+//a push which throws releases the lock of its heap, with a single heap the next push or pop would wait for it forever
+bool multiQueueThrowingPush() {
+	MultiQueue<FragileKey> queue(1, 1);
+	FragileKey key(7);
+	queue.push(key);
+	FragileKey::failMoves = true;
+	bool thrown = false;
+	try {
+		queue.push(key);
+	}
+	catch (const runtime_error&) {
+		thrown = true;
+	}
+	FragileKey::failMoves = false;
+	queue.push(FragileKey(3));
+	FragileKey popped(0);
+	return check(thrown, "the push throws") && check(queue.tryPop(popped) && popped.key_ == 3, "the heap is unlocked after the throw");
+}
+
+//min() must not rebase the buckets on the key it peeks: 50 is pushed after peeking 100 and has to come out first
+bool radixPeekThenPush() {
+	radixMinPriorityQ<uint32_t> queue;
+	queue.push(5);
+	queue.push(100);
+	queue.extractMin();
+	if (!check(queue.min() == 100, "the minimum after 5 is 100")) {
+		return false;
+	}
+	queue.push(50);
+	if (!check(queue.min() == 50, "50 pushed after peeking 100 is the minimum")) {
+		return false;
+	}
+	queue.extractMin();
+	return check(queue.min() == 100, "100 comes out after 50");
+}
+
+//random pushes of keys not less than the last extracted one, peeks before and after them, against a multiset
+//every value is distinct, the entry extractMin removes has to be the one min and minValue reported
+bool radixRandom() {
+	mt19937_64 random(3);
+	for (int round = 0; round < 200; ++round) {
+		radixMinPriorityQ<uint64_t, uint64_t> queue;
+		multiset<pair<uint64_t, uint64_t>> expected;
+		uint64_t last = 0;
+		uint64_t pushes = 0;
+		for (int op = 0; op < 2000; ++op) {
+			uint64_t choice = random() % 4;
+			if (choice < 2 || expected.empty()) {
+				uint64_t key = last + (choice == 0 ? random() % 4 : random() % 100000);
+				queue.push(key, pushes);
+				expected.emplace(key, pushes++);
+			}
+			else if (choice == 2) {
+				if (!check(queue.min() == expected.begin()->first, "min is the least key")) {
+					return false;
+				}
+			}
+			else {
+				uint64_t key = queue.min();
+				auto entry = expected.find(make_pair(key, queue.minValue()));
+				if (!check(key == expected.begin()->first && entry != expected.end(), "min and minValue are a pushed entry with the least key")) {
+					return false;
+				}
+				last = key;
+				expected.erase(entry);
+				queue.extractMin();
+			}
+			if (!check(queue.size() == expected.size(), "size")) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+int main() {
+	if (!multiQueueRanks(1, 1) || !multiQueueRanks(1, 2) || !multiQueueRanks(4, 2) || !multiQueueRanks(16, 2) || !multiQueueRanks(64, 2)) {
+		return 1;
+	}
+	if (!multiQueueExactlyOnce(1) || !multiQueueExactlyOnce(4) || !multiQueueExactlyOnce(8)) {
+		return 1;
+	}
+	if (!multiQueueThrowingPush()) {
+		return 1;
+	}
+	if (!radixPeekThenPush() || !radixRandom()) {
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
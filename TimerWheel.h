@@ -0,0 +1,169 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+
+using namespace std;
+
+//Milliseconds of std::chrono::steady_clock, the default clock of LRUCache
+struct SteadyClock {
+	uint64_t now() const {
+		return static_cast<uint64_t>(chrono::duration_cast<chrono::milliseconds>(
+			chrono::steady_clock::now().time_since_epoch()).count());
+	}
+};
+
+//Clock which only moves when told to, for deterministic tests
+//it can be advanced while other threads read it, like the shards of a ShardedLRUCache
+class ManualClock {
+public:
+	ManualClock() = default;
+	ManualClock(const ManualClock& other) :now_{ other.now() }
+	{}
+	uint64_t now() const {
+		return now_;
+	}
+	void advance(uint64_t milliseconds) {
+		now_ += milliseconds;
+	}
+private:
+	atomic<uint64_t> now_{ 0 };
+};
+
+/*
+Hierarchical timing wheel of isbns expiring at given times (in the ticks of the clock, milliseconds)
+Level l has 64 slots of 64^l ticks each, a timer sits in the lowest level whose current rotation contains its time,
+in the slot of its time. When the time reaches the start of a slot of a higher level, that slot is cascaded:
+its timers move down into the finer slots. Every timer is cascaded at most once per level, so scheduling,
+cancelling and expiring are O(1) amortized, no matter how many timers there are.
+Timers further away than the 4 levels cover (64^4 ticks, about 4.6 hours) wait in an overflow list
+which is checked whenever the top level completes a rotation.
+*/
+class TimerWheel {
+	struct Timer {
+		int isbn;
+		uint64_t expiry;
+		//levelCount for the overflow list
+		size_t level;
+		list<Timer>* slot;
+	};
+public:
+	typedef list<Timer>::iterator handle;
+
+	bool empty() const {
+		return count_ == 0;
+	}
+
+	//the timer expires on the first advance to expiry or later
+	handle schedule(int isbn, uint64_t expiry) {
+		++count_;
+		list<Timer> incoming;
+		incoming.push_front({ isbn, expiry, 0, nullptr });
+		handle timer = incoming.begin();
+		//the current tick is done already
+		place(incoming, timer, current_ + 1);
+		return timer;
+	}
+	static uint64_t expiry(handle timer) {
+		return timer->expiry;
+	}
+	//handle has to be a timer which didn't expire yet
+	void cancel(handle timer) {
+		--count_;
+		--sizes_[timer->level];
+		timer->slot->erase(timer);
+	}
+
+	//calls expired(isbn) for every timer up to now, the timer is gone by then
+	template<typename Function>
+	void advance(uint64_t now, Function expired) {
+		while (current_ < now) {
+			size_t level = 0;
+			while (level <= levelCount && sizes_[level] == 0) {
+				++level;
+			}
+			if (level > levelCount) {
+				current_ = now;
+				return;
+			}
+			if (level > 0) {
+				//the lower levels are empty, nothing expires before the next non empty slot of this level starts
+				uint64_t skipTo = current_ | ((uint64_t(1) << (levelBits * level)) - 1);
+				if (level < levelCount) {
+					//the timers of a level are all in slots after the one of the current time
+					size_t shift = levelBits * level;
+					size_t slot = ((current_ >> shift) & slotMask) + 1;
+					while (levels_[level][slot].empty()) {
+						++slot;
+					}
+					skipTo = ((((current_ >> (shift + levelBits)) << levelBits) | slot) << shift) - 1;
+				}
+				if (skipTo >= now) {
+					current_ = now;
+					return;
+				}
+				current_ = skipTo;
+			}
+			++current_;
+			cascade();
+			list<Timer>& due = levels_[0][current_ & slotMask];
+			while (!due.empty()) {
+				int isbn = due.front().isbn;
+				due.pop_front();
+				--sizes_[0];
+				--count_;
+				expired(isbn);
+			}
+		}
+	}
+private:
+	static constexpr size_t levelBits = 6;
+	static constexpr size_t slotMask = (1 << levelBits) - 1;
+	static constexpr size_t levelCount = 4;
+
+	array<array<list<Timer>, slotMask + 1>, levelCount> levels_;
+	list<Timer> overflow_;
+	//timers per level, the last one is the overflow list
+	array<size_t, levelCount + 1> sizes_ = {};
+	//last tick advanced to, the timers of every earlier tick expired
+	uint64_t current_ = 0;
+	size_t count_ = 0;
+
+	//moves the timer from the list it is in to its slot for the current time, a timer due before earliest goes to its slot
+	void place(list<Timer>& from, handle timer, uint64_t earliest) {
+		uint64_t expiry = max(timer->expiry, earliest);
+		list<Timer>* slot = &overflow_;
+		size_t level = 0;
+		for (; level < levelCount; ++level) {
+			size_t shift = levelBits * (level + 1);
+			if ((expiry >> shift) == (current_ >> shift)) {
+				slot = &levels_[level][(expiry >> (levelBits * level)) & slotMask];
+				break;
+			}
+		}
+		timer->level = level;
+		timer->slot = slot;
+		++sizes_[level];
+		slot->splice(slot->begin(), from, timer);
+	}
+
+	//moves the timers of the higher level slots starting at current_ down, coarsest first
+	void cascade() {
+		size_t level = 1;
+		while (level <= levelCount && (current_ & ((uint64_t(1) << (levelBits * level)) - 1)) == 0) {
+			++level;
+		}
+		while (--level > 0) {
+			list<Timer> timers;
+			//timers of the overflow list can end up in it again
+			timers.swap(level == levelCount ? overflow_ : levels_[level][(current_ >> (levelBits * level)) & slotMask]);
+			sizes_[level] -= timers.size();
+			while (!timers.empty()) {
+				place(timers, timers.begin(), current_);
+			}
+		}
+	}
+};
@@ -0,0 +1,196 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+Fixed set of worker threads, each with its own deque of tasks
+A worker pushes the tasks it spawns to the back of its own deque and takes its next task from the back too,
+so it keeps working on the most recently split (smallest, cache hot) piece of work.
+An idle worker steals from the front of the other deques, where the oldest and largest pieces are.
+Threads waiting for a TaskGroup run pending tasks meanwhile, so nested fork-join never deadlocks.
+*/
+class WorkStealingPool {
+public:
+	explicit WorkStealingPool(size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency()))
+		:queues_(threads)
+	{
+		for (size_t i = 0; i < threads; ++i) {
+			queues_[i].reset(new Queue());
+		}
+		for (size_t i = 0; i < threads; ++i) {
+			workers_.emplace_back([this, i] { work(i); });
+		}
+	}
+	WorkStealingPool(const WorkStealingPool& pool) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool& pool) = delete;
+	//tasks still queued are run before the workers exit
+	~WorkStealingPool() {
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex_);
+			stop_ = true;
+		}
+		wake_.notify_all();
+		for (std::thread& worker : workers_) {
+			worker.join();
+		}
+	}
+
+	//Pool with one worker per core, created on first use
+	static WorkStealingPool& shared() {
+		static WorkStealingPool pool;
+		return pool;
+	}
+
+	size_t size() const {
+		return workers_.size();
+	}
+
+	//Queues the task, on the calling worker's own deque when called from one of the workers
+	void submit(std::function<void()> task) {
+		size_t index = current().pool_ == this ? current().index_ : next_++ % queues_.size();
+		//counted before it is visible so that the count never drops below the number of queued tasks
+		++pending_;
+		{
+			std::lock_guard<std::mutex> lock(queues_[index]->mutex_);
+			queues_[index]->tasks_.push_back(std::move(task));
+		}
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex_);
+		}
+		wake_.notify_one();
+	}
+
+	//Runs one pending task if there is any, returns false otherwise
+	bool runPending() {
+		std::function<void()> task;
+		if (!take(task)) {
+			return false;
+		}
+		task();
+		return true;
+	}
+private:
+	struct alignas(64) Queue {
+		std::mutex mutex_;
+		std::deque<std::function<void()>> tasks_;
+	};
+	//which pool and worker the current thread is, if it is a worker (zero initialized, no pool otherwise)
+	struct Worker {
+		WorkStealingPool* pool_;
+		size_t index_;
+	};
+	//a function local thread_local rather than an inline static member, which would need C++17
+	static Worker& current() {
+		static thread_local Worker worker;
+		return worker;
+	}
+
+	std::vector<std::unique_ptr<Queue>> queues_;
+	std::vector<std::thread> workers_;
+	std::atomic<size_t> pending_{ 0 };
+	std::atomic<size_t> next_{ 0 };
+	std::mutex sleepMutex_;
+	std::condition_variable wake_;
+	bool stop_ = false;
+
+	void work(size_t index) {
+		current().pool_ = this;
+		current().index_ = index;
+		while (true) {
+			if (runPending()) {
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(sleepMutex_);
+			wake_.wait(lock, [this] { return stop_ || pending_ > 0; });
+			if (stop_ && pending_ == 0) {
+				return;
+			}
+		}
+	}
+
+	//own deque from the back first, then steal from the front of the others
+	bool take(std::function<void()>& task) {
+		size_t own = current().pool_ == this ? current().index_ : 0;
+		for (size_t i = 0; i < queues_.size(); ++i) {
+			Queue& queue = *queues_[(own + i) % queues_.size()];
+			std::lock_guard<std::mutex> lock(queue.mutex_);
+			if (queue.tasks_.empty()) {
+				continue;
+			}
+			if (i == 0 && current().pool_ == this) {
+				task = std::move(queue.tasks_.back());
+				queue.tasks_.pop_back();
+			}
+			else {
+				task = std::move(queue.tasks_.front());
+				queue.tasks_.pop_front();
+			}
+			--pending_;
+			return true;
+		}
+		return false;
+	}
+};
+
+/*
+Tasks forked on a pool which can be waited for together
+wait() runs pending tasks of the pool until all the tasks of the group are done,
+and rethrows the first exception one of them threw
+*/
+class TaskGroup {
+public:
+	explicit TaskGroup(WorkStealingPool& pool) :pool_{ pool }
+	{}
+	TaskGroup(const TaskGroup& group) = delete;
+	TaskGroup& operator=(const TaskGroup& group) = delete;
+	~TaskGroup() {
+		waitAll();
+	}
+
+	template<typename Function>
+	void run(Function function) {
+		++remaining_;
+		pool_.submit([this, function]() mutable {
+			try {
+				function();
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(errorMutex_);
+				if (!error_) {
+					error_ = std::current_exception();
+				}
+			}
+			--remaining_;
+		});
+	}
+
+	void wait() {
+		waitAll();
+		if (error_) {
+			std::exception_ptr error = error_;
+			error_ = nullptr;
+			std::rethrow_exception(error);
+		}
+	}
+private:
+	WorkStealingPool& pool_;
+	std::atomic<size_t> remaining_{ 0 };
+	std::mutex errorMutex_;
+	std::exception_ptr error_;
+
+	void waitAll() {
+		while (remaining_ > 0) {
+			if (!pool_.runPending()) {
+				std::this_thread::yield();
+			}
+		}
+	}
+};